@@ -0,0 +1,112 @@
+#ifndef __CHECKPOINT_FILE__
+#define __CHECKPOINT_FILE__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace generic_control_toolbox
+{
+  /**
+    Memory-mapped file holding the latest checkpoint of a controller, i.e.,
+    its serialized goal and controller state, so that a restarted controller
+    process can resume the goal. The file holds a CheckpointHeader, followed
+    by two slots of capacity bytes, aligned to a cache line:
+
+      uint64 seq              increases with every checkpoint
+      uint32 goal_size
+      uint32 state_size
+      uint32 crc              CRC-32 of the sizes, seq and data
+      uint8 data[capacity]    the goal followed by the state
+
+    Checkpoints are written alternately to both slots, and loading takes the
+    newest slot with a valid CRC, so a process which dies while writing a
+    checkpoint leaves the previous one intact. The mapping is shared with the
+    page cache, which keeps the checkpoint across process crashes, but not
+    across host crashes.
+  **/
+  const char CHECKPOINT_MAGIC[8] = {'G', 'C', 'T', 'C', 'K', 'P', 'T', '\0'};
+  const uint32_t CHECKPOINT_VERSION = 1;
+  const uint32_t CHECKPOINT_TYPE_LENGTH = 128;
+
+  struct CheckpointHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    char type[CHECKPOINT_TYPE_LENGTH]; /// identifies the goal type, null-padded
+  };
+
+  struct CheckpointSlot
+  {
+    uint64_t seq;
+    uint32_t goal_size;
+    uint32_t state_size;
+    uint32_t crc;
+  };
+
+  class CheckpointFile
+  {
+  public:
+    CheckpointFile();
+    ~CheckpointFile();
+
+    /**
+      Opens or creates a checkpoint file. An existing file with a different
+      type or capacity is discarded.
+
+      @param file_name The checkpoint file.
+      @param type Identifies the goal type, e.g., its message type and MD5 sum.
+      @param capacity The maximum size of a checkpoint, in bytes.
+      @return True in case of success, false otherwise.
+    **/
+    bool open(const std::string &file_name, const std::string &type, uint32_t capacity);
+
+    void close();
+    bool isOpen() const;
+
+    /**
+      Reads the latest checkpoint.
+
+      @param goal The serialized goal.
+      @param state The serialized controller state.
+      @return False if there is no valid checkpoint or if it has no goal, true otherwise.
+    **/
+    bool load(std::vector<uint8_t> &goal, std::vector<uint8_t> &state) const;
+
+    /**
+      Writes a checkpoint. Not real-time safe, as it may block on page faults.
+
+      @param goal The serialized goal.
+      @param state The serialized controller state.
+      @return False if the checkpoint exceeds the capacity, true otherwise.
+    **/
+    bool save(const std::vector<uint8_t> &goal, const std::vector<uint8_t> &state);
+
+    /**
+      Writes an empty checkpoint, e.g., after the goal ends.
+    **/
+    void clear();
+
+  private:
+    CheckpointSlot *slot(unsigned int i) const;
+    uint8_t *slotData(unsigned int i) const;
+
+    /**
+      @return The CRC-32 of a slot.
+    **/
+    uint32_t checksum(unsigned int i) const;
+
+    /**
+      @return The index of the newest valid slot, or -1 if there is none.
+    **/
+    int newestSlot() const;
+
+    std::string file_name_;
+    uint8_t *addr_;
+    uint64_t bytes_, slot_bytes_;
+    uint32_t capacity_;
+    uint64_t seq_;
+  };
+}
+#endif
@@ -0,0 +1,121 @@
+#ifndef __COMMAND_FILTER__
+#define __COMMAND_FILTER__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <urdf/model.h>
+#include <Eigen/Dense>
+#include <memory>
+
+namespace generic_control_toolbox
+{
+  /**
+    Enforces joint limits on the controller commands before they are sent
+    to the robot. The position, velocity and effort limits are read from the
+    URDF model, and the acceleration and jerk limits, and the position
+    deadband, from the parameters of the filter namespace:
+
+      max_acceleration, max_jerk, deadband    defaults for all joints
+      joints/<joint>/max_acceleration, ...    per joint overrides
+
+    Commanded positions are limited in value, and their changes in velocity,
+    acceleration and jerk, and approach their targets no faster than the
+    acceleration limit allows to stop at them. Commanded velocities are
+    limited in value, acceleration and jerk. Position changes smaller than
+    the deadband are suppressed. All joints are filtered together with
+    vectorized operations on the command arrays, and each limit keeps a
+    violation counter per joint.
+  **/
+  class CommandFilter
+  {
+  public:
+    CommandFilter();
+    ~CommandFilter();
+
+    /**
+      Reads the filter parameters and loads the robot model.
+
+      @param nh The node handle of the filter namespace.
+      @param robot_description The robot description parameter.
+    **/
+    void init(const ros::NodeHandle &nh, const std::string &robot_description = "/robot_description");
+
+    /**
+      Restarts the rate limits from the measured joint state, e.g., when a
+      controller becomes active, so that its first command cannot jump away
+      from the robot. Joints missing from the state start from their first
+      command.
+
+      @param state The measured joint state.
+    **/
+    void reset(const sensor_msgs::JointState &state);
+
+    /**
+      Limits a command in place. Allocation-free while the commanded joints
+      do not change. With a dt which is not positive or exceeds MAX_DT, the
+      previous command is held, since its rates cannot be limited.
+
+      @param command The command to limit.
+      @param dt The time since the previous command, in seconds.
+      @return The number of limits which were violated.
+    **/
+    unsigned int filter(sensor_msgs::JointState &command, double dt);
+
+    /**
+      Logs the violation counters of the joints whose limits were violated.
+    **/
+    void logViolations() const;
+
+  private:
+    typedef Eigen::Array<unsigned long, Eigen::Dynamic, 1> Counters;
+
+    /**
+      Drops the previous command, so the rate limits restart from the seed
+      state or from the next command.
+    **/
+    void reset();
+
+    /**
+      Starts the rate limits from the seed state.
+
+      @param names The commanded joints.
+      @return False if the seed state misses some of the joints, true otherwise.
+    **/
+    bool seedLimits(const std::vector<std::string> &names);
+
+    /**
+      Loads the limits of the commanded joints.
+
+      @param names The commanded joints.
+    **/
+    void loadLimits(const std::vector<std::string> &names);
+
+    /**
+      Limits the velocity, acceleration and jerk of a command channel.
+
+      @param v The commanded velocities, limited on return.
+      @param v_prev The previous limited velocities.
+      @param a_prev The previous accelerations.
+      @param dt The time since the previous command.
+      @return The number of limits which were violated.
+    **/
+    unsigned int limitRates(Eigen::ArrayXd &v, Eigen::ArrayXd &v_prev, Eigen::ArrayXd &a_prev, double dt);
+
+    /**
+      Reads a per-joint parameter, with the filter default as fallback.
+    **/
+    double jointParam(const std::string &joint, const std::string &name, double default_value) const;
+
+    ros::NodeHandle nh_;
+    std::shared_ptr<const urdf::Model> model_;
+    std::vector<std::string> names_;
+    double default_max_acceleration_, default_max_jerk_, default_deadband_;
+    Eigen::ArrayXd lower_, upper_, max_velocity_, max_effort_, max_acceleration_, max_jerk_, deadband_;
+    Eigen::ArrayXd q_prev_, qv_prev_, qa_prev_, v_prev_, va_prev_, v_;
+    Eigen::ArrayXd a_;
+    Counters position_violations_, velocity_violations_, acceleration_violations_, jerk_violations_, effort_violations_;
+    sensor_msgs::JointState seed_;
+    bool has_prev_position_, has_prev_velocity_, has_seed_;
+  };
+}
+#endif
@@ -0,0 +1,106 @@
+#ifndef __COMMAND_INTERPOLATOR__
+#define __COMMAND_INTERPOLATOR__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <urdf/model.h>
+#include <generic_control_toolbox/robot_model_cache.hpp>
+#include <generic_control_toolbox/single_slot_buffer.hpp>
+#include <generic_control_toolbox/controller_template.hpp>
+#include <generic_control_toolbox/realtime_command_publisher.hpp>
+#include <atomic>
+#include <thread>
+
+namespace generic_control_toolbox
+{
+  /**
+    Streams joint commands at a higher rate than the controller which
+    computes them. Each new controller command starts a cubic Hermite segment
+    from the current interpolated position and velocity to the commanded
+    ones, so the streamed positions and velocities are continuous. The
+    streamed commands respect the URDF joint velocity limits.
+
+    The interpolation runs on its own thread, and the commands are handed
+    over by the controller thread without locking. The interpolated commands
+    are published through a RealtimeCommandPublisher, so the interpolation
+    thread neither serializes nor allocates.
+  **/
+  class CommandInterpolator
+  {
+  public:
+    CommandInterpolator();
+    ~CommandInterpolator();
+
+    /**
+      Starts the interpolation thread.
+
+      @param pub The publisher for the interpolated commands.
+      @param rate The rate at which commands are streamed.
+      @param priority SCHED_FIFO priority of the interpolation thread. Zero keeps the default scheduling.
+      @param poll_rate The rate at which the publishing thread checks for new commands, which should be larger than rate.
+      @param cpu The CPU the publishing thread is pinned to. Negative values do not pin it.
+      @param shared Whether to publish each command in a new message shared pointer, see RealtimeCommandPublisher.
+      @return False if something goes wrong, true otherwise.
+    **/
+    bool start(const ros::Publisher &pub, double rate, int priority, double poll_rate, int cpu, bool shared = false);
+
+    /**
+      Stops the interpolation thread.
+    **/
+    void stop();
+
+    /**
+      Sets the command to interpolate to. Lock-free and, after the first
+      call, allocation-free.
+
+      @param command The controller command.
+      @param duration The time in which the command should be reached, typically the controller period.
+      @param active If false, the command is published once and streaming stops until an active command is set.
+    **/
+    void setTarget(const sensor_msgs::JointState &command, const ros::Duration &duration, bool active);
+
+  private:
+    struct Target
+    {
+      sensor_msgs::JointState command;
+      double duration;
+      bool active;
+    };
+
+    /**
+      Interpolation thread loop.
+    **/
+    void interpolationThread();
+
+    /**
+      Starts a new interpolation segment towards the given target.
+
+      @param target The new target.
+    **/
+    void startSegment(const Target &target);
+
+    /**
+      Evaluates the current segment at the given time and writes the result,
+      limited by the joint velocity limits, in command_.
+
+      @param t The time since the start of the segment.
+    **/
+    void evaluate(double t);
+
+    /**
+      Reads the velocity limits of the commanded joints from the URDF model.
+    **/
+    void loadLimits();
+
+    RealtimeCommandPublisher publisher_;
+    std::shared_ptr<const urdf::Model> model_;
+    bool has_model_, streaming_;
+    double period_, segment_time_, segment_duration_;
+    std::vector<double> q0_, v0_, q1_, v1_, velocity_limits_;
+    sensor_msgs::JointState command_;
+    SingleSlotBuffer<Target> targets_;
+    std::thread thread_;
+    std::atomic<bool> stop_;
+  };
+}
+#endif
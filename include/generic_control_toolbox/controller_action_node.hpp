@@ -2,8 +2,21 @@
 #define __CONTROLLER_ACTION_NODE__
 
 #include <generic_control_toolbox/controller_template.hpp>
+#include <generic_control_toolbox/command_interpolator.hpp>
+#include <generic_control_toolbox/flight_recorder.hpp>
+#include <generic_control_toolbox/latency_tracer.hpp>
+#include <generic_control_toolbox/realtime_command_publisher.hpp>
+#include <generic_control_toolbox/shm_transport.hpp>
+#include <generic_control_toolbox/joint_projection.hpp>
+#include <generic_control_toolbox/joint_state_estimator.hpp>
+#include <generic_control_toolbox/joint_state_predictor.hpp>
+#include <generic_control_toolbox/command_filter.hpp>
 #include <sensor_msgs/JointState.h>
+#include <ros/callback_queue.h>
 #include <stdexcept>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 namespace generic_control_toolbox
 {
@@ -15,28 +28,211 @@ namespace generic_control_toolbox
   class ControllerActionNode
   {
   public:
+    /**
+      Reads the node parameters from the private namespace. runController
+      serves all the callbacks of the process.
+    **/
     ControllerActionNode();
+
+    /**
+      Reads the node parameters from the given namespace. The joint states
+      are subscribed to from the joint_state_topic parameter and the
+      commands published on the command_topic parameter, so several nodes
+      can run in one process. runController only serves the joint state
+      callbacks, so the owner must spin the global callback queue, which
+      serves the actionlib servers of the controllers.
+
+      With zero_copy set, the node keeps a reference to the received joint
+      state messages instead of copying them, and publishes each command in
+      a new message shared pointer, so that intra-process publishers and
+      subscribers, e.g., nodelets, exchange them without serialization. The
+      received messages must not be modified by their publisher.
+
+      @param nh The node handle of the node namespace.
+      @param zero_copy Whether to exchange messages by shared pointer.
+    **/
+    explicit ControllerActionNode(const ros::NodeHandle &nh, bool zero_copy = false);
+
     ~ControllerActionNode();
 
     /**
       This blocking method will run the controller by providing
-      it with the currently available joint states and time intervals
-      between calls. It will publish the controller output to the robot
-      command topic.
+      it with the currently available joint states and the time elapsed
+      between the measurements it consumes. It will publish the controller
+      output to the robot command topic.
+
+      If the joint states stop arriving, or their stamps stop advancing, for
+      longer than the max_state_age parameter, the node will hold the last commanded position or, if the
+      stale_state_policy parameter is set to "abort", abort the controller.
+
+      If the command_rate parameter is larger than the loop rate, the
+      controller commands are interpolated and streamed at command_rate by
+      a separate thread. Otherwise, they are serialized and published by a
+      non real-time thread, which checks for new commands at the
+      command_publisher/poll_rate parameter and is pinned to the
+      command_publisher/cpu parameter, if set.
+
+      If the flight_recorder/file parameter is set, the inputs and outputs
+      of every controller update are recorded to that file.
+
+      The published commands carry the header stamp of the joint state they
+      were computed from. If the latency_statistics_period parameter is set,
+      the latency percentiles of each stage of the loop are published on the
+      latency_statistics topic with that period.
+
+      If the shm_transport parameter is set, the joint states and commands
+      are exchanged with a driver on the same host through shared memory
+      instead of ROS topics, with the same topic names. The command layout
+      is fixed by the first command.
+
+      If the joint_group parameter lists joint names, the joint states are
+      projected onto those joints when they are received, and only those
+      joints are sent in the commands, so the cost of each cycle depends on
+      the size of the group instead of the size of the robot.
+
+      If the state_estimator/enabled parameter is set, the joint velocities
+      given to the controller are estimated from the joint positions by a
+      JointStateEstimator with the state_estimator/alpha, state_estimator/beta
+      and state_estimator/gamma gains.
+
+      If the state_predictor/enabled parameter is set, the controller is
+      given the joint state extrapolated, with the estimated velocities and
+      accelerations, to the time of the control update plus the
+      state_predictor/actuation_delay parameter, in seconds. The prediction
+      error is logged every state_predictor/log_period seconds. The state
+      estimator is enabled with the predictor.
+
+      If the command_filter/enabled parameter is set, the controller
+      commands are limited by a CommandFilter, configured in the
+      command_filter namespace, before being sent to the robot. The flight
+      recorder records the unfiltered commands.
 
       @param controller Any controller which complies with ControllerBase.
     **/
     void runController(ControllerBase &controller);
 
+    /**
+      Replaces the running controller without stopping the control loop. The
+      incoming controller is prepared with prepareSwitch by a background
+      thread, and takes over at the start of the first control cycle after
+      that: it is seeded with the last command of the outgoing controller,
+      which is then aborted. Can be called from any thread, e.g., from a
+      service callback.
+
+      @param next The incoming controller, which must outlive runController.
+      @return False if another switch is in progress, true otherwise.
+    **/
+    bool switchController(ControllerBase &next);
+
+    /**
+      Makes runController return. Can be called from any thread.
+    **/
+    void stop();
+
   private:
+    enum SwitchStage {SWITCH_NONE, SWITCH_PREPARING, SWITCH_READY};
+
+    /**
+      Prepares the incoming controller of a switch.
+    **/
+    void prepareSwitch();
+
+    /**
+      Hands over control to the prepared incoming controller and reports the
+      switch latency.
+
+      @param controller The running controller, replaced by the incoming one.
+      @param command The last command of the running controller.
+    **/
+    void completeSwitch(ControllerBase *&controller, const sensor_msgs::JointState &command);
+
     void jointStatesCb(const sensor_msgs::JointState::ConstPtr &msg);
 
+    /**
+      Reads the latest joint state from shared memory, opening the joint
+      state topic if needed.
+    **/
+    void readSharedState();
+
+    /**
+      Projects a received joint state onto the joint group into state_.
+
+      @param msg The received joint state.
+      @return False if the joint state does not have all the group joints, true otherwise.
+    **/
+    bool projectState(const sensor_msgs::JointState &msg);
+
+    /**
+      Stores a new joint state.
+
+      @param stamp The measurement time of state_, zero if unknown.
+    **/
+    void newState(const ros::Time &stamp);
+
+    /**
+      @return The latest joint state, either the received message or its copy.
+    **/
+    const sensor_msgs::JointState &currentState() const;
+
+    /**
+      Logs the prediction error statistics once per log period.
+
+      @param now The current time.
+    **/
+    void logPredictionError(const ros::Time &now);
+
+    /**
+      Sets the given command to hold the commanded joint positions.
+
+      @param command The command to modify.
+    **/
+    void holdPosition(sensor_msgs::JointState &command) const;
+
+    /**
+      Sends the joint group part of a command to the robot, either directly
+      or through the interpolator.
+
+      @param full_command The command to send.
+      @param active Whether the controller is active.
+      @param trace If given, the latency trace of the cycle. Its publish time
+      is set when the command is sent from the control thread, and left
+      empty when the publishing thread traces it.
+    **/
+    void publishCommand(const sensor_msgs::JointState &full_command, bool active, LatencyTrace *trace = nullptr);
+
     ros::NodeHandle nh_;
     sensor_msgs::JointState state_;
+    sensor_msgs::JointState::ConstPtr state_msg_; /// latest message in zero-copy mode
+    sensor_msgs::JointState shm_state_, group_command_; /// buffers for the joint group projections
+    JointProjection state_projection_, command_projection_;
+    JointStateEstimator estimator_;
+    JointStatePredictor predictor_;
+    CommandFilter filter_;
+    sensor_msgs::JointState predicted_state_;
+    ros::Time prediction_log_time_;
+    double prediction_log_period_;
+    ros::Time state_stamp_, state_receive_time_; /// measurement and reception times of state_
     ros::Subscriber joint_state_sub_;
+    ros::CallbackQueue state_queue_; /// serves the joint state callbacks
+    bool spin_global_queue_;
     ros::Publisher state_pub_;
-    bool got_first_;
-    double loop_rate_;
+    RealtimeCommandPublisher command_publisher_;
+    ShmJointStateReader shm_reader_;
+    ShmJointStateWriter shm_writer_;
+    std::string joint_state_topic_, command_topic_;
+    CommandInterpolator interpolator_;
+    FlightRecorder recorder_;
+    LatencyTracer tracer_;
+    ros::Publisher latency_pub_;
+    std::string record_file_;
+    int record_capacity_, record_block_size_;
+    ControllerBase *next_controller_;
+    std::atomic<int> switch_stage_;
+    std::atomic<bool> stop_;
+    std::thread switch_thread_;
+    std::chrono::steady_clock::time_point switch_request_time_, switch_ready_time_;
+    bool got_first_, new_state_, abort_on_stale_, interpolate_, shm_transport_, zero_copy_, estimate_state_, predict_state_, filter_commands_;
+    double loop_rate_, max_state_age_;
   };
 }
 #endif
@@ -0,0 +1,132 @@
+#ifndef __CONTROLLER_ACTION_NODELET__
+#define __CONTROLLER_ACTION_NODELET__
+
+#include <nodelet/nodelet.h>
+#include <generic_control_toolbox/controller_action_node.hpp>
+#include <generic_control_toolbox/realtime_utils.hpp>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+namespace generic_control_toolbox
+{
+  /**
+    Runs a ControllerBase implementation in a ControllerActionNode loaded as
+    a nodelet. When the robot driver is a nodelet in the same manager, the
+    joint states and commands are exchanged as shared pointers, without
+    serialization or copies.
+
+    The node parameters are read from the nodelet private namespace, and the
+    controller is constructed with the action name given by the action_name
+    parameter. Controllers which forward the (action_name, nh) constructor of
+    ControllerTemplate are given the nodelet private node handle, so their
+    parameters and action server are in the nodelet namespace. Otherwise,
+    they are in the private namespace of the nodelet manager, shared by all
+    the nodelets it loads. The control loop runs in its own thread, with the SCHED_FIFO
+    priority given by the priority parameter and pinned to the CPU given by
+    the cpu parameter, if set. The actionlib callbacks are served by the
+    nodelet manager.
+
+    Since pluginlib requires concrete classes, the nodelet must be exported
+    by the package which implements the controller, e.g.,
+
+      PLUGINLIB_EXPORT_CLASS(generic_control_toolbox::ControllerActionNodelet<MyController>, nodelet::Nodelet)
+  **/
+  template <class Controller>
+  class ControllerActionNodelet : public nodelet::Nodelet
+  {
+  public:
+    ControllerActionNodelet();
+    virtual ~ControllerActionNodelet();
+
+  private:
+    virtual void onInit();
+
+    /**
+      Constructs the controller in the nodelet namespace, if it supports it.
+    **/
+    template <class C>
+    static typename std::enable_if<std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type createController(const std::string &action_name, const ros::NodeHandle &nh);
+
+    /**
+      Constructs the controller in the namespace of the nodelet manager.
+    **/
+    template <class C>
+    static typename std::enable_if<!std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type createController(const std::string &action_name, const ros::NodeHandle &nh);
+
+    BasePtr controller_;
+    std::shared_ptr<ControllerActionNode> node_;
+    std::thread thread_;
+  };
+
+  template <class Controller>
+  ControllerActionNodelet<Controller>::ControllerActionNodelet() {}
+
+  template <class Controller>
+  ControllerActionNodelet<Controller>::~ControllerActionNodelet()
+  {
+    if (node_)
+    {
+      node_->stop();
+    }
+
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+  template <class Controller>
+  void ControllerActionNodelet<Controller>::onInit()
+  {
+    ros::NodeHandle &nh = getPrivateNodeHandle();
+    std::string action_name;
+    int priority, cpu;
+
+    if (!nh.getParam("action_name", action_name))
+    {
+      NODELET_ERROR_STREAM("Missing action_name parameter in " << nh.getNamespace());
+      return;
+    }
+
+    if (!nh.getParam("priority", priority))
+    {
+      priority = 0;
+    }
+
+    if (!nh.getParam("cpu", cpu))
+    {
+      cpu = -1; // not pinned
+    }
+
+    controller_ = BasePtr(createController<Controller>(action_name, nh));
+    node_ = std::shared_ptr<ControllerActionNode>(new ControllerActionNode(nh, true));
+    thread_ = std::thread(&ControllerActionNode::runController, node_.get(), std::ref(*controller_)); // onInit must not block
+
+    if (priority > 0)
+    {
+      setThreadPriority(thread_, priority);
+    }
+
+    if (cpu >= 0)
+    {
+      setThreadAffinity(thread_, cpu);
+    }
+  }
+
+  template <class Controller>
+  template <class C>
+  typename std::enable_if<std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type ControllerActionNodelet<Controller>::createController(const std::string &action_name, const ros::NodeHandle &nh)
+  {
+    return new C(action_name, nh);
+  }
+
+  template <class Controller>
+  template <class C>
+  typename std::enable_if<!std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type ControllerActionNodelet<Controller>::createController(const std::string &action_name, const ros::NodeHandle &nh)
+  {
+    ROS_WARN("The controller of %s does not take a node handle, its parameters and action server are in the namespace of the nodelet manager", nh.getNamespace().c_str());
+    return new C(action_name);
+  }
+}
+#endif
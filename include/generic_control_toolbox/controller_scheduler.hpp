@@ -0,0 +1,129 @@
+#ifndef __CONTROLLER_SCHEDULER__
+#define __CONTROLLER_SCHEDULER__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <generic_control_toolbox/controller_template.hpp>
+#include <generic_control_toolbox/single_slot_buffer.hpp>
+#include <generic_control_toolbox/realtime_utils.hpp>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <map>
+
+namespace generic_control_toolbox
+{
+  /**
+    Runs several controllers in one process. The joint states are received
+    and deserialized once and shared by all the controllers, which run at
+    their own rates in a pool of worker threads. The commands of the
+    controllers in the same joint group are merged and published together on
+    the <joint_group>/joint_command topic.
+
+    The pool is configured with the workers parameter (number of worker
+    threads, default 1) and the worker_cpus parameter (list with the CPU each
+    worker is pinned to, by default they are not pinned). The merged commands
+    are published at the publish_rate parameter (default 100).
+  **/
+  class ControllerScheduler
+  {
+  public:
+    ControllerScheduler();
+    ~ControllerScheduler();
+
+    /**
+      Adds a controller to the scheduler. Must be called before run.
+
+      A controller updates at most once for each joint state it receives.
+      Controllers are distributed across the workers by decreasing priority,
+      and each worker thread runs with the SCHED_FIFO priority of its
+      highest priority controller.
+
+      @param controller The controller.
+      @param rate The controller update rate.
+      @param priority The controller priority. Zero keeps the default scheduling.
+      @param joint_group The name of the joint group where the controller commands are merged.
+      @return False if the controller cannot be added, true otherwise.
+    **/
+    bool addController(BasePtr controller, double rate, int priority, const std::string &joint_group);
+
+    /**
+      This blocking method runs the controllers until ROS shuts down.
+    **/
+    void run();
+
+  private:
+    struct ControllerOutput
+    {
+      sensor_msgs::JointState command;
+      ros::Time stamp; /// measurement time of the state the command was computed from
+      bool active;
+    };
+
+    struct ScheduledController
+    {
+      BasePtr controller;
+      std::chrono::nanoseconds period;
+      int priority;
+      unsigned int group;
+      ros::Time last_stamp; /// measurement time of the last state given to the controller
+      SingleSlotBuffer<ControllerOutput> output;
+      bool was_running;
+    };
+
+    struct Worker
+    {
+      std::vector<unsigned int> controllers; /// by decreasing priority
+      SingleSlotBuffer<sensor_msgs::JointState> state;
+      std::thread thread;
+      int priority;
+    };
+
+    struct JointGroup
+    {
+      std::string name;
+      std::vector<unsigned int> controllers;
+      std::map<std::string, unsigned int> index; /// position of each joint in the merged command
+      std::vector<unsigned int> fields; /// mask of the fields received for each joint, see POSITION_FIELD
+      sensor_msgs::JointState command;
+      ros::Publisher pub;
+    };
+
+    static const unsigned int POSITION_FIELD = 1, VELOCITY_FIELD = 2, EFFORT_FIELD = 4;
+
+    void jointStatesCb(const sensor_msgs::JointState::ConstPtr &msg);
+
+    /**
+      Runs the controllers assigned to a worker, each at its rate.
+
+      @param w The worker index.
+    **/
+    void workerThread(unsigned int w);
+
+    /**
+      Merges the latest outputs of the running controllers in a joint group
+      into the group command, which is stamped with the latest state they
+      were computed from. The joints of stopped controllers are dropped
+      after their last command. A field, e.g., the positions, is published
+      only if every merged joint has it, and groups where only some joints
+      have a field are rejected, since the driver would take the missing
+      values as zero.
+
+      @param group The joint group.
+      @return True if the group command should be published, false otherwise.
+    **/
+    bool mergeGroup(JointGroup &group);
+
+    ros::NodeHandle nh_;
+    ros::Subscriber joint_state_sub_;
+    std::vector<std::shared_ptr<ScheduledController> > controllers_;
+    std::vector<std::shared_ptr<Worker> > workers_;
+    std::vector<JointGroup> groups_;
+    std::vector<int> worker_cpus_;
+    std::atomic<bool> running_, stop_threads_;
+    int num_workers_;
+    double publish_rate_;
+  };
+}
+#endif
@@ -2,14 +2,85 @@
 #define __CONTROLLER_TEMPLATE__
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <sensor_msgs/JointState.h>
 #include <actionlib/server/simple_action_server.h>
+#include <ros/serialization.h>
+#include <ros/message_traits.h>
+#include <generic_control_toolbox/single_slot_buffer.hpp>
+#include <generic_control_toolbox/deadline.hpp>
+#include <generic_control_toolbox/checkpoint_file.hpp>
 #include <cmath>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <boost/lockfree/spsc_queue.hpp>
 
 namespace generic_control_toolbox
 {
   const double MAX_DT = 0.5;
 
+  /**
+    Copies a joint state message into another one. Memory is only allocated
+    if the output does not have the capacity for the input, and the joint
+    names are only copied if they differ.
+
+    @param in The joint state to copy.
+    @param out The copy.
+  **/
+  void copyJointState(const sensor_msgs::JointState &in, sensor_msgs::JointState &out);
+
+  /**
+    Selects the offline constructor of a controller, e.g.,
+    ControllerTemplate(action_name, OFFLINE). Offline controllers do not
+    create node handles or an actionlib server, and their goals are given
+    with injectGoal. Used to replay controllers without a ROS master.
+  **/
+  struct Offline {};
+  const Offline OFFLINE = Offline();
+
+  /**
+    Callback queue of the action server of a ControllerTemplate, served by
+    its server thread. Unlike ros::CallbackQueue, the server thread can also
+    be woken up while it waits for callbacks, e.g., to report a result.
+  **/
+  class ServerCallbackQueue : public ros::CallbackQueueInterface
+  {
+  public:
+    ServerCallbackQueue();
+
+    virtual void addCallback(const ros::CallbackInterfacePtr &callback, uint64_t owner_id = 0);
+    virtual void removeByID(uint64_t owner_id);
+
+    /**
+      Waits until a callback is queued, wake is called or the deadline
+      passes, and calls the queued callbacks.
+
+      @param deadline The time until which to wait.
+    **/
+    void waitAndCall(const std::chrono::steady_clock::time_point &deadline);
+
+    /**
+      Wakes up waitAndCall.
+    **/
+    void wake();
+
+    /**
+      Wakes up waitAndCall without taking the mutex, so it can be called from
+      the control thread. The wake up is lost if it races with waitAndCall
+      going to sleep, delaying it until the deadline.
+    **/
+    void notify();
+
+  private:
+    ros::CallbackQueue queue_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<bool> pending_; /// a callback was queued or wake was called
+  };
+
   /**
   Defines the basic cartesian controller interface.
   **/
@@ -29,6 +100,18 @@ namespace generic_control_toolbox
     **/
     virtual sensor_msgs::JointState updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt) = 0;
 
+    /**
+      In-place version of updateControl, which writes the desired joint states
+      into a caller-owned command. Defaults to copying the output of
+      updateControl; controllers should override it to avoid allocating a new
+      joint state message every cycle.
+
+      @param current_state Current joint states.
+      @param dt Elapsed time since last control loop.
+      @param command Desired joint states.
+    **/
+    virtual void updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command);
+
     /**
       Indicates if the controller is active.
 
@@ -40,36 +123,241 @@ namespace generic_control_toolbox
       Allows resetting the internal controller state.
     **/
     virtual void resetInternalState() = 0;
+
+    /**
+      Stops the controller due to an external failure, e.g., when the joint
+      state measurements stop arriving. Defaults to resetting the internal
+      controller state.
+    **/
+    virtual void abortControl();
+
+    /**
+      Prepares the controller to replace a running one. Called from a
+      background thread while the outgoing controller is still running.
+      Defaults to resetting the internal controller state.
+
+      @return False if the controller cannot take over, true otherwise.
+    **/
+    virtual bool prepareSwitch();
+
+    /**
+      Gives the controller the last command of the controller it replaces, so
+      that its output continues from it. Only called on an idle controller,
+      which the control thread is not running yet. Defaults to doing nothing.
+
+      @param command The last command of the outgoing controller.
+    **/
+    virtual void seedCommand(const sensor_msgs::JointState &command);
+
+    /**
+      Identifies the goal being executed, e.g., in the flight records. Called
+      from the control thread. Defaults to 0.
+
+      @return The sequence number of the goal, which increases with every
+      goal, or 0 if there is none.
+    **/
+    virtual unsigned int goalSequence() const;
   };
 
   /**
     A controller interface which implements the SimpleActionServer actionlib
     protocol.
+
+    The action server is served by a background thread, which runs its
+    callbacks on a dedicated callback queue, reports the goal results and
+    publishes the actionlib feedback at the rate given by the
+    <action_name>/feedback_rate parameter, so that the control thread never
+    blocks on actionlib. As this thread is the only one to call the action
+    server, a goal is never accepted between the check and the report of the
+    result of the previous one.
+
+    New goals are prepared by a worker thread with prepareGoal, and swapped
+    into the controller with parseGoal by the control thread at the start of
+    the next control cycle after the preparation finishes. Until then, the
+    controller keeps executing the previous goal.
+
+    The goal lifecycle is kept in a lock-free state machine, which the
+    actionlib callbacks update and the control thread reads. The control
+    thread reports the goal results through a lock-free queue, drained by the
+    server thread, so it never takes the action server mutex. Only the
+    control thread touches the controller data, including the reset after a
+    preemption.
+
+    If the <action_name>/cycle_budget parameter is set, controlAlgorithm is
+    given a time budget, in seconds, which it can check with deadline. When
+    it is exceeded, the output of controlAlgorithm is replaced by
+    fallbackCommand and the miss is counted.
+
+    The action server and the background threads call the virtual methods of
+    the controller, so they only run between start and shutdown. Controllers
+    should call start at the end of their constructor, otherwise the first
+    updateControl does, and must call shutdown in their destructor.
+
+    If the <action_name>/checkpoint/file parameter is set, the control thread
+    snapshots the active goal and the state given by serializeState every
+    <action_name>/checkpoint/period seconds, and a background thread writes
+    the snapshots to the memory-mapped file. When the controller process
+    restarts, the checkpointed goal is resumed in the first control cycle,
+    with the state given to deserializeState. A resumed goal has no actionlib
+    client, so its result is not reported.
   **/
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
   class ControllerTemplate : public ControllerBase
   {
   public:
+    /**
+      Reads the parameters and serves the action server in the private
+      namespace of the node.
+
+      @param action_name The action name.
+    **/
     ControllerTemplate(const std::string &action_name);
+
+    /**
+      Reads the parameters and serves the action server in the given
+      namespace, e.g., the private namespace of a nodelet.
+
+      @param action_name The action name.
+      @param nh The node handle of the namespace.
+    **/
+    ControllerTemplate(const std::string &action_name, const ros::NodeHandle &nh);
+
+    /**
+      Constructs an offline controller, which reads no parameters and has
+      no action server.
+
+      @param action_name The action name.
+      @param offline OFFLINE.
+    **/
+    ControllerTemplate(const std::string &action_name, Offline offline);
     virtual ~ControllerTemplate();
 
+    /**
+      Starts the action server and the background threads, which call
+      prepareGoal and the other virtual methods. Controllers should call it
+      at the end of their constructor, once these methods can run. Otherwise,
+      it is called by the first updateControl. Does nothing once started,
+      after shutdown, or offline.
+    **/
+    void start();
+
     /**
       Wraps the control algorithm with actionlib-related management.
     **/
     virtual sensor_msgs::JointState updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt);
 
+    /**
+      Wraps the control algorithm with actionlib-related management. Does not
+      allocate memory once the command has the size of the joint state.
+    **/
+    virtual void updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command);
+
     virtual bool isActive() const;
 
     virtual void resetInternalState();
 
+    /**
+      Aborts the active actionlib goal, if any, and resets the controller.
+    **/
+    virtual void abortControl();
+
+    /**
+      Resets the controller while holding goal_mutex_, so the reset does not
+      race with a goal being prepared by the goal thread.
+    **/
+    virtual bool prepareSwitch();
+
+    /**
+      Holds the positions of the given command, with null velocities, until
+      the controller gets a goal. Only seeds an idle controller: it is not
+      synchronized with updateControl, so it must not be called while the
+      control thread is running the controller.
+    **/
+    virtual void seedCommand(const sensor_msgs::JointState &command);
+
+    virtual unsigned int goalSequence() const;
+
+    /**
+      Gives a goal to an offline controller, replacing the actionlib server.
+
+      @param goal The goal.
+      @return False if the controller is not offline or if the goal is rejected, true otherwise.
+    **/
+    bool injectGoal(boost::shared_ptr<const ActionGoal> goal);
+
+    /**
+      Preempts the goal of an offline controller.
+    **/
+    void cancelGoal();
+
+    /**
+      @return The number of control cycles which exceeded the cycle budget.
+    **/
+    unsigned long budgetMisses() const;
+
   protected:
     /**
-      Implementation of the actual control method.
+      @param action_name The action name.
+      @param nh The node handle of the namespace, or an empty pointer for the private namespace of the node.
+    **/
+    ControllerTemplate(const std::string &action_name, boost::shared_ptr<ros::NodeHandle> nh, bool offline = false);
+
+    /**
+      Stops the background threads and the action server. Controllers must
+      call it in their destructor, since prepareGoal cannot run once they are
+      destroyed.
+    **/
+    void shutdown();
+
+    /**
+      Implementation of the actual control method. Controllers which
+      implement the in-place version must also implement this one, e.g., by
+      calling the in-place version with a local command.
     **/
     virtual sensor_msgs::JointState controlAlgorithm(const sensor_msgs::JointState &current_state, const ros::Duration &dt) = 0;
 
     /**
-      Read goal data.
+      In-place implementation of the actual control method, which is the one
+      called by updateControl. The command keeps its memory between calls,
+      so controllers which fill it in without resizing it run without heap
+      allocations. Defaults to calling the by-value version.
+
+      @param current_state Current joint states.
+      @param dt Elapsed time since last control loop.
+      @param command Desired joint states.
+    **/
+    virtual void controlAlgorithm(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command);
+
+    /**
+      Prepares the goal data in a worker thread, concurrently with
+      controlAlgorithm. Expensive goal processing, e.g., inverse kinematics
+      or trajectory fitting, should be done here, storing the results in
+      variables which are not used by controlAlgorithm. Defaults to doing
+      nothing.
+
+      @param goal The goal pointer from actionlib.
+      @return True in case of success, false otherwise.
+    **/
+    virtual bool prepareGoal(boost::shared_ptr<const ActionGoal> goal);
+
+    /**
+      Computes a cheap command for the cycles in which controlAlgorithm
+      exceeds the cycle budget. Defaults to repeating the previous command.
+
+      @param current_state Current joint states.
+      @param dt Elapsed time since last control loop.
+      @param command Desired joint states.
+    **/
+    virtual void fallbackCommand(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command);
+
+    /**
+      @return The deadline of the current control cycle.
+    **/
+    const Deadline &deadline() const;
+
+    /**
+      Read goal data. Called by the control thread once prepareGoal succeeds,
+      so it should only swap in the prepared data.
 
       @param goal The goal pointer from actionlib.
       @return True in case of success, false otherwise.
@@ -92,11 +380,81 @@ namespace generic_control_toolbox
     **/
     sensor_msgs::JointState lastState(const sensor_msgs::JointState &current);
 
-    boost::shared_ptr<actionlib::SimpleActionServer<ActionClass> > action_server_;
+    /**
+      In-place version of lastState.
+
+      @param current The current joint state.
+      @param out The last commanded joint state.
+    **/
+    void lastState(const sensor_msgs::JointState &current, sensor_msgs::JointState &out);
+
+    /**
+      @return The goal being executed, or an empty pointer if there is none.
+    **/
+    boost::shared_ptr<const ActionGoal> activeGoal() const;
+
+    /**
+      Serializes the controller state, e.g., integrators, filters and the
+      trajectory progress, for the checkpoint of the active goal. Called by
+      the control thread, so it should fill in the data without shrinking
+      it, which then keeps its memory between calls. Defaults to saving no
+      state, in which case a resumed goal starts from parseGoal.
+
+      @param data The serialized state.
+      @return False if there is no state to save, true otherwise.
+    **/
+    virtual bool serializeState(std::vector<uint8_t> &data);
+
+    /**
+      Restores the controller state of a resumed goal, after parseGoal.
+      The data may come from an older version of the controller, so it
+      should be validated.
+
+      @param data The state given by serializeState.
+      @return False if the state cannot be restored, true otherwise.
+    **/
+    virtual bool deserializeState(const std::vector<uint8_t> &data);
+
+    /**
+      Sets the current goal as succeeded, with result_. Controllers must use
+      this method and setAborted to end their goals, as the action server is
+      only accessed by the background threads, so that they can also run
+      offline and do not block the control thread.
+    **/
+    void setSucceeded();
+
+    /**
+      Sets the current goal as aborted, with result_.
+    **/
+    void setAborted();
+
+    /**
+      Forwarding helpers for the controllers which used the action server
+      directly, before it became private. They go through the same
+      background threads as the methods above.
+    **/
+    void setSucceeded(const ActionResult &result);
+    void setAborted(const ActionResult &result);
+
+    /**
+      Sets the feedback published at the next feedback period.
+    **/
+    void publishFeedback(const ActionFeedback &feedback);
+
+    /**
+      Checks if the current goal is being preempted.
+
+      @return True if the goal was preempted and the controller did not end
+      it yet.
+    **/
+    bool isPreemptRequested() const;
+
     ActionFeedback feedback_;
     ActionResult result_;
 
   private:
+    boost::shared_ptr<actionlib::SimpleActionServer<ActionClass> > action_server_;
+
     /**
       Method that manages the starting of the actionlib server of each cartesian
     controller.
@@ -104,7 +462,8 @@ namespace generic_control_toolbox
     void startActionlib();
 
     /**
-      Goal callback method.
+      Goal callback method. Accepts the new goal and hands it over to the
+      goal thread through a lock-free slot.
     **/
     virtual bool goalCB();
 
@@ -118,138 +477,928 @@ namespace generic_control_toolbox
     **/
     void resetFlags();
 
+    /**
+      Serves the action server: runs its callbacks, reports the results of
+      the control thread and publishes its feedback at the feedback rate.
+    **/
+    void serverThread();
+
+    /**
+      Prepares the goals received by goalCB.
+    **/
+    void goalThread();
+
+    /**
+      Swaps in the goal prepared by the goal thread. Called by the control
+      thread.
+    **/
+    void commitGoal();
+
+    /**
+      Ends the current goal and reports its result to the action server
+      through the result queue, waking up the server thread.
+
+      @param succeeded Whether the goal succeeded or got aborted.
+    **/
+    void finishGoal(bool succeeded);
+
+    /**
+      Reports the results queued by the control thread to the action server,
+      unless their goal was already replaced. Called by the server thread,
+      like goalCB, so no goal can be accepted in between.
+    **/
+    void reportResults();
+
+    /**
+      Reads the checkpoint parameters and loads the checkpointed goal, if any.
+    **/
+    void loadCheckpoint();
+
+    /**
+      Starts the goal loaded from the checkpoint. Called by the control
+      thread in its first cycle.
+    **/
+    void resumeGoal();
+
+    /**
+      Hands a snapshot of the active goal over to the checkpoint thread at
+      the checkpoint period, and an empty one once the goal ends.
+
+      @param dt Elapsed time since last control loop.
+    **/
+    void checkpoint(const ros::Duration &dt);
+
+    /**
+      Writes the snapshots of the control thread to the checkpoint file.
+    **/
+    void checkpointThread();
+
+    enum GoalStage {GOAL_IDLE, GOAL_READY};
+    enum GoalState {IDLE, PENDING, ACTIVE, PREEMPTING, DONE};
+
+    struct ResultReport
+    {
+      unsigned int seq;
+      bool succeeded;
+      ActionResult result;
+    };
+
+    struct GoalHandover
+    {
+      boost::shared_ptr<const ActionGoal> goal;
+      unsigned int seq;
+    };
+
+    struct CheckpointSnapshot
+    {
+      boost::shared_ptr<const ActionGoal> goal; /// empty once the goal ends
+      std::vector<uint8_t> state;
+    };
 
     std::string action_name_;
-    ros::NodeHandle nh_;
-    sensor_msgs::JointState last_state_;
-    bool has_state_, acquired_goal_;
+    boost::shared_ptr<ros::NodeHandle> nh_;
+    sensor_msgs::JointState last_state_, last_command_;
+    bool has_state_, has_command_, acquired_goal_, offline_;
+    Deadline deadline_;
+    double cycle_budget_;
+    std::atomic<unsigned long> budget_misses_;
+    std::atomic<int> goal_state_;
+    std::atomic<unsigned int> preempt_seq_; /// increases with every preemption, to be handled by the control thread
+    unsigned int handled_preempt_seq_, active_seq_;
+    boost::lockfree::spsc_queue<ResultReport, boost::lockfree::capacity<16> > results_;
+    SingleSlotBuffer<ActionFeedback> feedback_buffer_;
+    std::thread server_thread_, goal_thread_, checkpoint_thread_;
+    std::atomic<bool> started_, stop_threads_;
+    ServerCallbackQueue server_queue_;
+    SingleSlotBuffer<GoalHandover> goal_slot_; /// the accepted goals, from the server thread to the goal thread
+    boost::shared_ptr<const ActionGoal> prepared_goal_, active_goal_;
+    std::mutex handover_mutex_; /// protects new_goal_, only held to wake up the goal thread
+    std::mutex goal_mutex_; /// serializes prepareGoal with the resets from other threads, never taken by the control thread
+    std::condition_variable goal_cv_;
+    bool new_goal_;
+    std::atomic<unsigned int> goal_stage_, goal_seq_; /// goal_seq_ increases with every new goal and preemption
+    unsigned int prepared_seq_;
+    bool prepared_ok_;
+    double feedback_rate_, time_since_feedback_;
+    CheckpointFile checkpoint_file_;
+    SingleSlotBuffer<CheckpointSnapshot> checkpoint_buffer_;
+    boost::shared_ptr<const ActionGoal> resume_goal_;
+    std::vector<uint8_t> resume_state_, checkpoint_goal_;
+    double checkpoint_period_, time_since_checkpoint_;
+    bool checkpointed_; /// whether the checkpoint file holds a goal
   };
 
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::ControllerTemplate(const std::string &action_name) : action_name_(action_name)
-  {
-    nh_ = ros::NodeHandle("~");
-    resetFlags();
-    startActionlib();
-  }
+  ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::ControllerTemplate(const std::string &action_name) : ControllerTemplate(action_name, boost::shared_ptr<ros::NodeHandle>()) {}
 
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  sensor_msgs::JointState ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt)
+  ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::ControllerTemplate(const std::string &action_name, const ros::NodeHandle &nh) : ControllerTemplate(action_name, boost::shared_ptr<ros::NodeHandle>(new ros::NodeHandle(nh))) {}
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::ControllerTemplate(const std::string &action_name, Offline offline) : ControllerTemplate(action_name, boost::shared_ptr<ros::NodeHandle>(), true) {}
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::ControllerTemplate(const std::string &action_name, boost::shared_ptr<ros::NodeHandle> nh, bool offline) : action_name_(action_name), offline_(offline), cycle_budget_(0.0), budget_misses_(0), goal_state_(IDLE), preempt_seq_(0), handled_preempt_seq_(0), active_seq_(0), started_(false), stop_threads_(false), new_goal_(false), goal_stage_(GOAL_IDLE), goal_seq_(0), prepared_seq_(0), prepared_ok_(false), feedback_rate_(20), time_since_feedback_(0.0), checkpoint_period_(0.0), time_since_checkpoint_(0.0), checkpointed_(false)
   {
-    if (!action_server_->isActive() || !acquired_goal_)
+    resetFlags();
+
+    if (offline_)
     {
-      return lastState(current_state);
+      ROS_INFO("%s initialized offline", action_name_.c_str());
+      return;
     }
 
-    ROS_DEBUG_THROTTLE(10, "Calling %s control algorithm", action_name_.c_str());
-    if (dt.toSec() > MAX_DT) // lost communication for too much time
+    nh_ = nh ? nh : boost::shared_ptr<ros::NodeHandle>(new ros::NodeHandle("~"));
+
+    if (!nh_->getParam(action_name_ + "/feedback_rate", feedback_rate_))
     {
-      ROS_ERROR_STREAM(action_name_ << " did not receive updates for more than " << MAX_DT << " seconds, aborting");
-      action_server_->setAborted(result_);
-      return lastState(current_state);
+      ROS_WARN("Missing %s/feedback_rate parameter. Using default.", action_name_.c_str());
+      feedback_rate_ = 20;
     }
 
-    sensor_msgs::JointState ret = controlAlgorithm(current_state, dt);
-    action_server_->publishFeedback(feedback_);
-
-    if (!action_server_->isActive())
+    if (feedback_rate_ <= 0)
     {
-      resetInternalState();
+      ROS_ERROR("%s/feedback_rate must be positive. Using default.", action_name_.c_str());
+      feedback_rate_ = 20;
     }
 
-    // verify sanity of values
-    for (unsigned int i = 0; i < ret.name.size(); i++)
+    if (!nh_->getParam(action_name_ + "/cycle_budget", cycle_budget_))
     {
-      if (!std::isfinite(ret.position[i]) || !std::isfinite(ret.velocity[i]))
-      {
-        ROS_ERROR("Invalid joint states in %s", action_name_.c_str());
-        return lastState(current_state);
-      }
+      cycle_budget_ = 0.0; // no budget
     }
 
-    return ret;
+    loadCheckpoint();
   }
 
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::isActive() const
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::start()
   {
-    if (!action_server_->isActive())
+    if (stop_threads_ || started_.exchange(true) || offline_)
     {
-      return false;
+      return;
     }
 
-    return true;
-  }
+    startActionlib();
+    server_thread_ = std::thread(&ControllerTemplate::serverThread, this);
+    goal_thread_ = std::thread(&ControllerTemplate::goalThread, this);
 
-  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::resetInternalState()
-  {
-    resetFlags();
-    resetController();
+    if (checkpoint_file_.isOpen())
+    {
+      checkpoint_thread_ = std::thread(&ControllerTemplate::checkpointThread, this);
+    }
   }
 
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::resetFlags()
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::shutdown()
   {
-    has_state_ = false;
-    acquired_goal_ = false;
-  }
+    {
+      std::lock_guard<std::mutex> lock(handover_mutex_);
+      stop_threads_ = true;
+    }
 
-  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  sensor_msgs::JointState ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::lastState(const sensor_msgs::JointState &current)
-  {
-    if (current.position.size() == 0) // Invalid state
+    goal_cv_.notify_one();
+    server_queue_.wake();
+    if (server_thread_.joinable())
     {
-      ROS_WARN("lastState got invalid state");
-      return last_state_;
+      server_thread_.join();
     }
 
-    if(!has_state_)
+    if (goal_thread_.joinable())
     {
-      last_state_ = current;
-      for (unsigned long i = 0; i < last_state_.velocity.size(); i++)
-      {
-        last_state_.velocity[i] = 0.0;
-      }
+      goal_thread_.join();
+    }
 
-      has_state_ = true;
+    if (checkpoint_thread_.joinable())
+    {
+      checkpoint_thread_.join();
     }
 
-    return last_state_;
+    if (action_server_)
+    {
+      action_server_->shutdown(); // the callbacks queued meanwhile are never called
+    }
   }
 
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::goalCB()
+  sensor_msgs::JointState ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt)
   {
-    boost::shared_ptr<const ActionGoal> goal = action_server_->acceptNewGoal();
+    sensor_msgs::JointState ret;
+    updateControl(current_state, dt, ret);
+    return ret;
+  }
 
-    if (!parseGoal(goal))
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command)
+  {
+    if (!started_)
     {
-      action_server_->setAborted(result_);
-      return false;
+      start(); // the controller is fully constructed by now
     }
 
-    acquired_goal_ = true;
-    ROS_INFO("New goal received in %s", action_name_.c_str());
-    return true;
-  }
+    deadline_.start(cycle_budget_);
 
-  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::preemptCB()
-  {
-    action_server_->setPreempted(result_);
+    unsigned int preempt_seq = preempt_seq_.load(std::memory_order_acquire);
+    if (preempt_seq != handled_preempt_seq_)
+    {
+      handled_preempt_seq_ = preempt_seq;
+      resetInternalState();
+      int preempting = PREEMPTING;
+      goal_state_.compare_exchange_strong(preempting, IDLE);
+    }
+
+    if (goal_stage_.load(std::memory_order_acquire) == GOAL_READY)
+    {
+      commitGoal();
+    }
+
+    if (resume_goal_)
+    {
+      resumeGoal();
+    }
+
+    if (checkpoint_period_ > 0)
+    {
+      checkpoint(dt);
+    }
+
+    if (!isActive() || !acquired_goal_)
+    {
+      lastState(current_state, command);
+      return;
+    }
+
+    ROS_DEBUG_THROTTLE(10, "Calling %s control algorithm", action_name_.c_str());
+    if (dt.toSec() > MAX_DT) // lost communication for too much time
+    {
+      ROS_ERROR_STREAM(action_name_ << " did not receive updates for more than " << MAX_DT << " seconds, aborting");
+      setAborted();
+      lastState(current_state, command);
+      return;
+    }
+
+    controlAlgorithm(current_state, dt, command);
+
+    if (deadline_.expired())
+    {
+      budget_misses_++;
+      ROS_WARN_THROTTLE(1, "%s exceeded its cycle budget of %.3f ms, using the fallback command", action_name_.c_str(), cycle_budget_*1000);
+      fallbackCommand(current_state, dt, command);
+    }
+
+    time_since_feedback_ += dt.toSec();
+    if (!offline_ && time_since_feedback_ >= 1.0/feedback_rate_)
+    {
+      feedback_buffer_.write(feedback_);
+      time_since_feedback_ = 0.0;
+    }
+
+    if (!isActive() || !acquired_goal_)
+    {
+      resetInternalState();
+    }
+
+    // verify sanity of values
+    for (unsigned int i = 0; i < command.name.size(); i++)
+    {
+      if (!std::isfinite(command.position[i]) || !std::isfinite(command.velocity[i]))
+      {
+        ROS_ERROR("Invalid joint states in %s", action_name_.c_str());
+        lastState(current_state, command);
+        return;
+      }
+    }
+
+    copyJointState(command, last_command_);
+    has_command_ = true;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::fallbackCommand(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command)
+  {
+    if (!has_command_)
+    {
+      lastState(current_state, command);
+      return;
+    }
+
+    copyJointState(last_command_, command);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  const Deadline &ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::deadline() const
+  {
+    return deadline_;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  unsigned long ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::budgetMisses() const
+  {
+    return budget_misses_;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::controlAlgorithm(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command)
+  {
+    command = controlAlgorithm(current_state, dt);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::isActive() const
+  {
+    int state = goal_state_.load(std::memory_order_acquire);
+    return state == PENDING || state == ACTIVE;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::resetInternalState()
+  {
+    resetFlags();
+    resetController();
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::abortControl()
+  {
+    if (isActive())
+    {
+      ROS_ERROR("%s aborted by the controller runner", action_name_.c_str());
+      setAborted();
+    }
+
+    resetInternalState();
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::prepareSwitch()
+  {
+    std::lock_guard<std::mutex> lock(goal_mutex_);
+    resetInternalState();
+    return true;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::seedCommand(const sensor_msgs::JointState &command)
+  {
+    if (command.position.size() == 0)
+    {
+      return;
+    }
+
+    copyJointState(command, last_state_);
+    for (unsigned long i = 0; i < last_state_.velocity.size(); i++)
+    {
+      last_state_.velocity[i] = 0.0; // hold the position, as lastState does
+    }
+
+    has_state_ = true;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  unsigned int ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::goalSequence() const
+  {
+    return acquired_goal_ ? active_seq_ + 1 : 0; // a resumed goal may have active_seq_ 0
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::injectGoal(boost::shared_ptr<const ActionGoal> goal)
+  {
+    if (!offline_)
+    {
+      ROS_ERROR("Tried to inject a goal in %s, which is using actionlib", action_name_.c_str());
+      return false;
+    }
+
+    goal_state_ = ACTIVE;
+    active_seq_ = ++goal_seq_;
+    if (!prepareGoal(goal) || !parseGoal(goal))
+    {
+      setAborted();
+      return false;
+    }
+
+    active_goal_ = goal;
+    acquired_goal_ = true;
+    ROS_INFO("New goal injected in %s", action_name_.c_str());
+    return true;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::cancelGoal()
+  {
+    if (!offline_ || !isActive())
+    {
+      return;
+    }
+
+    goal_state_ = IDLE;
     ROS_WARN("%s preempted!", action_name_.c_str());
     resetInternalState();
   }
 
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
-  ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::~ControllerTemplate() {}
+  boost::shared_ptr<const ActionGoal> ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::activeGoal() const
+  {
+    if (!acquired_goal_)
+    {
+      return boost::shared_ptr<const ActionGoal>();
+    }
+
+    return active_goal_;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::setSucceeded()
+  {
+    finishGoal(true);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::setAborted()
+  {
+    finishGoal(false);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::setSucceeded(const ActionResult &result)
+  {
+    result_ = result;
+    finishGoal(true);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::setAborted(const ActionResult &result)
+  {
+    result_ = result;
+    finishGoal(false);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::publishFeedback(const ActionFeedback &feedback)
+  {
+    feedback_ = feedback;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::isPreemptRequested() const
+  {
+    return goal_state_.load(std::memory_order_acquire) == PREEMPTING;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::finishGoal(bool succeeded)
+  {
+    int state = goal_state_.load(std::memory_order_acquire);
+    if (state != PENDING && state != ACTIVE)
+    {
+      return;
+    }
+
+    if (offline_)
+    {
+      goal_state_ = DONE;
+      return;
+    }
+
+    if (state == PENDING && acquired_goal_)
+    {
+      // the running goal was already replaced in the action server by the pending one
+      acquired_goal_ = false;
+      return;
+    }
+
+    unsigned int seq;
+    if (state == ACTIVE)
+    {
+      // a newer goal may have been accepted in the meantime, which must stay active
+      seq = active_seq_;
+      if (seq == goal_seq_)
+      {
+        goal_state_.compare_exchange_strong(state, DONE);
+      }
+    }
+    else
+    {
+      // the goal is still being prepared, with the sequence given by goalCB
+      seq = goal_seq_.load(std::memory_order_acquire);
+      if (goal_state_.compare_exchange_strong(state, DONE) && seq != goal_seq_)
+      {
+        // a newer goal was accepted before the state changed, which must stay pending
+        int done = DONE;
+        goal_state_.compare_exchange_strong(done, PENDING);
+      }
+    }
+
+    ResultReport report;
+    report.seq = seq;
+    report.succeeded = succeeded;
+    report.result = result_;
+    if (!results_.push(report))
+    {
+      ROS_ERROR("The result queue of %s is full, dropping result", action_name_.c_str());
+    }
+
+    server_queue_.notify(); // report without waiting for the next feedback period
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::reportResults()
+  {
+    ResultReport report;
+    while (results_.pop(report))
+    {
+      if (report.seq != goal_seq_ || !action_server_->isActive()) // the goal was already replaced
+      {
+        continue;
+      }
+
+      if (report.succeeded)
+      {
+        action_server_->setSucceeded(report.result);
+      }
+      else
+      {
+        action_server_->setAborted(report.result);
+      }
+    }
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::resetFlags()
+  {
+    has_state_ = false;
+    has_command_ = false;
+    acquired_goal_ = false;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  sensor_msgs::JointState ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::lastState(const sensor_msgs::JointState &current)
+  {
+    sensor_msgs::JointState ret;
+    lastState(current, ret);
+    return ret;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::lastState(const sensor_msgs::JointState &current, sensor_msgs::JointState &out)
+  {
+    if (current.position.size() == 0) // Invalid state
+    {
+      ROS_WARN("lastState got invalid state");
+      copyJointState(last_state_, out);
+      return;
+    }
+
+    if(!has_state_)
+    {
+      copyJointState(current, last_state_);
+      for (unsigned long i = 0; i < last_state_.velocity.size(); i++)
+      {
+        last_state_.velocity[i] = 0.0;
+      }
+
+      has_state_ = true;
+    }
+
+    copyJointState(last_state_, out);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::prepareGoal(boost::shared_ptr<const ActionGoal> goal)
+  {
+    return true;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::goalCB()
+  {
+    GoalHandover &handover = goal_slot_.writeBuffer();
+    handover.goal = action_server_->acceptNewGoal();
+    handover.seq = ++goal_seq_;
+    goal_state_ = PENDING;
+    goal_slot_.publish();
+
+    {
+      std::lock_guard<std::mutex> lock(handover_mutex_);
+      new_goal_ = true;
+    }
+
+    goal_cv_.notify_one();
+    ROS_INFO("New goal received in %s", action_name_.c_str());
+    return true;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::goalThread()
+  {
+    boost::shared_ptr<const ActionGoal> goal;
+    unsigned int seq;
+
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(handover_mutex_);
+        goal_cv_.wait(lock, [this]{ return new_goal_ || stop_threads_; });
+
+        if (stop_threads_)
+        {
+          return;
+        }
+
+        new_goal_ = false;
+      }
+
+      goal_slot_.update(); // only the latest goal is prepared
+      goal = goal_slot_.readBuffer().goal;
+      seq = goal_slot_.readBuffer().seq;
+
+      // the control thread may still be reading the previously prepared goal
+      while (goal_stage_.load(std::memory_order_acquire) == GOAL_READY)
+      {
+        if (stop_threads_)
+        {
+          return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      if (seq != goal_seq_) // superseded or preempted
+      {
+        continue;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(goal_mutex_);
+        prepared_ok_ = prepareGoal(goal);
+      }
+
+      prepared_goal_ = goal;
+      prepared_seq_ = seq;
+      goal_stage_.store(GOAL_READY, std::memory_order_release);
+    }
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::commitGoal()
+  {
+    // goals which were aborted or preempted while being prepared are not started
+    int state = goal_state_.load(std::memory_order_acquire);
+    if (prepared_seq_ == goal_seq_ && (state == PENDING || state == ACTIVE))
+    {
+      if (prepared_ok_ && parseGoal(prepared_goal_))
+      {
+        goal_state_.compare_exchange_strong(state, ACTIVE);
+        active_seq_ = prepared_seq_;
+        active_goal_ = prepared_goal_;
+        acquired_goal_ = true;
+        ROS_DEBUG("Started new goal in %s", action_name_.c_str());
+      }
+      else
+      {
+        ROS_ERROR("Failed to parse the goal of %s", action_name_.c_str());
+        acquired_goal_ = false;
+        setAborted();
+      }
+    }
+
+    goal_stage_.store(GOAL_IDLE, std::memory_order_release);
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::preemptCB()
+  {
+    if (action_server_->isNewGoalAvailable())
+    {
+      // replaced by a new goal, keep executing the current one until the new one is ready
+      return;
+    }
+
+    goal_seq_++; // drop the goal being prepared, if any
+    goal_state_ = PREEMPTING;
+    preempt_seq_++; // the control thread resets the controller
+    action_server_->setPreempted(result_);
+    ROS_WARN("%s preempted!", action_name_.c_str());
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::serverThread()
+  {
+    std::chrono::nanoseconds period(static_cast<long long>(1e9/feedback_rate_));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() + period;
+
+    while (!stop_threads_)
+    {
+      server_queue_.waitAndCall(next); // goalCB and preemptCB
+      reportResults();
+
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      if (now < next)
+      {
+        continue;
+      }
+
+      if (feedback_buffer_.update() && goal_state_ == ACTIVE && action_server_->isActive())
+      {
+        action_server_->publishFeedback(feedback_buffer_.readBuffer());
+      }
+
+      next += period;
+      if (next < now) // do not try to catch up after a slow callback
+      {
+        next = now + period;
+      }
+    }
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::~ControllerTemplate()
+  {
+    shutdown(); // in case the controller did not
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::serializeState(std::vector<uint8_t> &data)
+  {
+    return false;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::deserializeState(const std::vector<uint8_t> &data)
+  {
+    return false;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::loadCheckpoint()
+  {
+    std::string file_name;
+    if (!nh_->getParam(action_name_ + "/checkpoint/file", file_name) || file_name.empty())
+    {
+      return; // no checkpoint
+    }
+
+    if (!nh_->getParam(action_name_ + "/checkpoint/period", checkpoint_period_))
+    {
+      checkpoint_period_ = 0.1;
+    }
+
+    int capacity;
+    if (!nh_->getParam(action_name_ + "/checkpoint/capacity", capacity))
+    {
+      capacity = 65536;
+    }
+
+    if (checkpoint_period_ <= 0 || capacity <= 0)
+    {
+      ROS_ERROR("%s/checkpoint/period and %s/checkpoint/capacity must be positive, disabling the checkpoint", action_name_.c_str(), action_name_.c_str());
+      checkpoint_period_ = 0.0;
+      return;
+    }
+
+    // a goal of a different type must not be deserialized
+    std::string type = std::string(ros::message_traits::datatype<ActionGoal>()) + "/" + ros::message_traits::md5sum<ActionGoal>();
+    if (!checkpoint_file_.open(file_name, type, capacity))
+    {
+      ROS_ERROR("Failed to open the checkpoint of %s, disabling it", action_name_.c_str());
+      checkpoint_period_ = 0.0;
+      return;
+    }
+
+    if (!checkpoint_file_.load(checkpoint_goal_, resume_state_))
+    {
+      return; // no goal was running
+    }
+
+    try
+    {
+      boost::shared_ptr<ActionGoal> goal(new ActionGoal);
+      ros::serialization::IStream stream(checkpoint_goal_.data(), checkpoint_goal_.size());
+      ros::serialization::deserialize(stream, *goal);
+      resume_goal_ = goal;
+      checkpointed_ = true;
+      ROS_INFO("Loaded the checkpointed goal of %s", action_name_.c_str());
+    }
+    catch (std::exception &e)
+    {
+      ROS_ERROR("Failed to read the checkpointed goal of %s: %s", action_name_.c_str(), e.what());
+      resume_state_.clear();
+    }
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::resumeGoal()
+  {
+    boost::shared_ptr<const ActionGoal> goal;
+    goal.swap(resume_goal_);
+
+    int idle = IDLE;
+    if (!goal_state_.compare_exchange_strong(idle, ACTIVE))
+    {
+      ROS_WARN("%s received a new goal before resuming the checkpointed one, dropping it", action_name_.c_str());
+      std::vector<uint8_t>().swap(resume_state_);
+      return;
+    }
+
+    // runs in the control thread, since the controller is only fully constructed by now
+    active_seq_ = goal_seq_;
+    if (!prepareGoal(goal) || !parseGoal(goal))
+    {
+      ROS_ERROR("Failed to resume the checkpointed goal of %s", action_name_.c_str());
+      setAborted();
+      std::vector<uint8_t>().swap(resume_state_);
+      return;
+    }
+
+    active_goal_ = goal;
+    acquired_goal_ = true;
+
+    if (!resume_state_.empty() && !deserializeState(resume_state_))
+    {
+      ROS_WARN("Failed to restore the checkpointed state of %s, restarting its goal", action_name_.c_str());
+      resetController();
+      parseGoal(goal);
+    }
+
+    std::vector<uint8_t>().swap(resume_state_);
+    ROS_INFO("Resumed the checkpointed goal of %s. Its result will not be reported to an action client", action_name_.c_str());
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::checkpoint(const ros::Duration &dt)
+  {
+    bool active = isActive() && acquired_goal_;
+    if (!active && !checkpointed_)
+    {
+      return;
+    }
+
+    time_since_checkpoint_ += dt.toSec();
+    if (active && time_since_checkpoint_ < checkpoint_period_)
+    {
+      return;
+    }
+
+    CheckpointSnapshot &snapshot = checkpoint_buffer_.writeBuffer();
+    if (active)
+    {
+      snapshot.goal = active_goal_;
+      if (!serializeState(snapshot.state))
+      {
+        snapshot.state.clear();
+      }
+    }
+    else
+    {
+      snapshot.goal.reset();
+    }
+
+    checkpoint_buffer_.publish();
+    time_since_checkpoint_ = 0.0;
+    checkpointed_ = active;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::checkpointThread()
+  {
+    std::chrono::nanoseconds period(static_cast<long long>(1e9*checkpoint_period_));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+      if (checkpoint_buffer_.update())
+      {
+        const CheckpointSnapshot &snapshot = checkpoint_buffer_.readBuffer();
+        if (snapshot.goal)
+        {
+          uint32_t length = ros::serialization::serializationLength(*snapshot.goal);
+          checkpoint_goal_.resize(length);
+          ros::serialization::OStream stream(checkpoint_goal_.data(), length);
+          ros::serialization::serialize(stream, *snapshot.goal);
+          checkpoint_file_.save(checkpoint_goal_, snapshot.state);
+        }
+        else
+        {
+          checkpoint_file_.clear();
+        }
+      }
+
+      if (stop_threads_) // the last snapshot is kept, so a restarted controller resumes its goal
+      {
+        return;
+      }
+
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+  }
 
   template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
   void ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::startActionlib()
   {
-    // Initialize actionlib server
-    action_server_ = boost::shared_ptr<actionlib::SimpleActionServer<ActionClass> >(new actionlib::SimpleActionServer<ActionClass>(nh_, action_name_, false));
+    // Initialize actionlib server, with its callbacks called by the server thread
+    ros::NodeHandle server_nh(*nh_);
+    server_nh.setCallbackQueue(&server_queue_);
+    action_server_ = boost::shared_ptr<actionlib::SimpleActionServer<ActionClass> >(new actionlib::SimpleActionServer<ActionClass>(server_nh, action_name_, false));
 
     // Register callbacks
     action_server_->registerGoalCallback(boost::bind(&ControllerTemplate::goalCB, this));
@@ -0,0 +1,47 @@
+#ifndef __DEADLINE__
+#define __DEADLINE__
+
+#include <chrono>
+
+namespace generic_control_toolbox
+{
+  /**
+    Time budget of a control cycle. Given to controllers so that iterative
+    solvers, e.g., IK iteration loops, can stop before the budget is
+    exceeded.
+  **/
+  class Deadline
+  {
+  public:
+    Deadline();
+    ~Deadline();
+
+    /**
+      Starts the budget from the current time.
+
+      @param budget The budget in seconds. Non-positive values disable the deadline.
+    **/
+    void start(double budget);
+
+    /**
+      @return The time left before the deadline, in seconds. Negative if
+      the deadline has passed, and infinite if there is no deadline.
+    **/
+    double remaining() const;
+
+    /**
+      @return True if the deadline has passed, false otherwise or if there is no deadline.
+    **/
+    bool expired() const;
+
+    /**
+      @return True if there is a deadline, false otherwise.
+    **/
+    bool isSet() const;
+
+  private:
+    std::chrono::steady_clock::time_point end_;
+    bool set_;
+  };
+}
+#endif
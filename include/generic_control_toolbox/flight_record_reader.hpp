@@ -0,0 +1,86 @@
+#ifndef __FLIGHT_RECORD_READER__
+#define __FLIGHT_RECORD_READER__
+
+#include <generic_control_toolbox/flight_recorder.hpp>
+
+namespace generic_control_toolbox
+{
+  /**
+    Gives random access to the cycles of a flight record written by the
+    FlightRecorder. The file is memory-mapped, so the joint values are
+    returned as pointers into the file.
+  **/
+  class FlightRecordReader
+  {
+  public:
+    FlightRecordReader();
+    ~FlightRecordReader();
+
+    /**
+      Maps a flight record file.
+
+      @param file_name The flight record file.
+      @return False if the file cannot be mapped or is not a valid flight record, true otherwise.
+    **/
+    bool open(const std::string &file_name);
+
+    /**
+      Unmaps the flight record file.
+    **/
+    void close();
+
+    /**
+      @return The number of recorded cycles.
+    **/
+    uint64_t size() const;
+
+    /**
+      @return The recorded joint names.
+    **/
+    const std::vector<std::string> &jointNames() const;
+
+    /**
+      Accessors for the scalar values of cycle i.
+    **/
+    double time(uint64_t i) const;
+    double stamp(uint64_t i) const;
+    double dt(uint64_t i) const;
+    bool active(uint64_t i) const;
+    unsigned int goal(uint64_t i) const;
+
+    /**
+      Accessors for the joint values of cycle i. Each returns a pointer to
+      jointNames().size() values.
+    **/
+    const double *statePosition(uint64_t i) const;
+    const double *stateVelocity(uint64_t i) const;
+    const double *stateEffort(uint64_t i) const;
+    const double *commandPosition(uint64_t i) const;
+    const double *commandVelocity(uint64_t i) const;
+    const double *commandEffort(uint64_t i) const;
+
+    /**
+      Fills in the joint state given to the controller and the controller
+      output in cycle i.
+
+      @param i The cycle index.
+      @param state The recorded joint state.
+      @param command The recorded command.
+      @return False if i is out of range, true otherwise.
+    **/
+    bool getCycle(uint64_t i, sensor_msgs::JointState &state, sensor_msgs::JointState &command) const;
+
+  private:
+    /**
+      Returns a pointer to the start of the given column entry of cycle i.
+    **/
+    const double *scalarColumn(uint64_t i, unsigned int column) const;
+    const double *jointColumn(uint64_t i, unsigned int column) const;
+
+    const char *data_;
+    uint64_t file_bytes_, header_bytes_, block_bytes_, size_;
+    uint32_t num_joints_, block_size_;
+    std::vector<std::string> joint_names_;
+  };
+}
+#endif
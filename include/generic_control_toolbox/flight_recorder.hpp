@@ -0,0 +1,143 @@
+#ifndef __FLIGHT_RECORDER__
+#define __FLIGHT_RECORDER__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+
+namespace generic_control_toolbox
+{
+  /**
+    Binary flight record format. The file starts with a FlightRecordHeader,
+    followed by num_joints null-padded joint names of FLIGHT_RECORD_NAME_LENGTH
+    characters, followed by fixed-size blocks. Each block holds up to
+    block_size control cycles in a columnar layout:
+
+      uint32 count, uint32 reserved
+      float64 time[block_size]            cycle time
+      float64 stamp[block_size]           header stamp of the consumed joint state
+      float64 dt[block_size]              elapsed time given to the controller
+      float64 active[block_size]          1 if the controller was active, 0 otherwise
+      float64 goal[block_size]            sequence number of the executed goal, 0 if none
+      float64 state_position[block_size][num_joints]
+      float64 state_velocity[block_size][num_joints]
+      float64 state_effort[block_size][num_joints]
+      float64 command_position[block_size][num_joints]
+      float64 command_velocity[block_size][num_joints]
+      float64 command_effort[block_size][num_joints]
+
+    Only the last block may have count < block_size. Missing joint values are
+    stored as NaN.
+  **/
+  const char FLIGHT_RECORD_MAGIC[8] = {'G', 'C', 'T', 'F', 'R', 'E', 'C', '\0'};
+  const uint32_t FLIGHT_RECORD_VERSION = 2;
+  const uint32_t FLIGHT_RECORD_NAME_LENGTH = 64;
+  const unsigned int FLIGHT_RECORD_SCALAR_COLUMNS = 5, FLIGHT_RECORD_JOINT_COLUMNS = 6;
+
+  struct FlightRecordHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_joints;
+    uint32_t block_size;
+    uint32_t name_length;
+  };
+
+  /**
+    Size in bytes of one block of a flight record.
+
+    @param num_joints The number of recorded joints.
+    @param block_size The number of cycles in a block.
+    @return The block size in bytes.
+  **/
+  uint64_t flightRecordBlockBytes(uint32_t num_joints, uint32_t block_size);
+
+  /**
+    Records the inputs and outputs of every control cycle. The control thread
+    copies each cycle into a preallocated lock-free ring buffer, and a
+    background thread drains it into a flight record file. Cycles are
+    dropped, and counted, if the ring buffer is full.
+  **/
+  class FlightRecorder
+  {
+  public:
+    FlightRecorder();
+    ~FlightRecorder();
+
+    /**
+      Creates the flight record file and starts the writer thread.
+
+      @param file_name The flight record file.
+      @param joint_names The recorded joints. Commands are assumed to have the same joint ordering.
+      @param capacity The number of cycles the ring buffer can hold.
+      @param block_size The number of cycles in each file block.
+      @return False if something goes wrong, true otherwise.
+    **/
+    bool start(const std::string &file_name, const std::vector<std::string> &joint_names, unsigned int capacity, unsigned int block_size);
+
+    /**
+      Writes the remaining cycles to the file and stops the writer thread.
+    **/
+    void stop();
+
+    /**
+      @return True if the recorder was started.
+    **/
+    bool isRunning() const;
+
+    /**
+      Records one control cycle. Lock-free and allocation-free, to be called
+      from the control thread.
+
+      @param state The joint state given to the controller.
+      @param dt The elapsed time given to the controller.
+      @param command The controller output.
+      @param active Whether the controller is active.
+      @param goal The sequence number of the goal executed by the controller, 0 if none.
+      @return False if the cycle was dropped, true otherwise.
+    **/
+    bool record(const sensor_msgs::JointState &state, const ros::Duration &dt, const sensor_msgs::JointState &command, bool active, unsigned int goal);
+
+    /**
+      @return The number of cycles dropped due to a full ring buffer.
+    **/
+    uint64_t droppedCycles() const;
+
+    /**
+      @return The average time spent in record, in seconds.
+    **/
+    double averageRecordTime() const;
+
+  private:
+    /**
+      Writer thread loop.
+    **/
+    void writerThread();
+
+    /**
+      Moves the available cycles from the ring buffer to the current block,
+      and writes the block to the file.
+
+      @return False if writing fails, true otherwise.
+    **/
+    bool drain();
+
+    /**
+      Copies the joint values into a ring buffer record, or NaN if the sizes do not match.
+    **/
+    void copyJointValues(const std::vector<double> &values, double *out) const;
+
+    int fd_;
+    unsigned int num_joints_, capacity_, block_size_, stride_;
+    uint64_t header_bytes_, block_bytes_, block_index_;
+    uint32_t block_count_;
+    std::vector<double> ring_;
+    std::vector<char> block_;
+    std::atomic<uint64_t> head_, tail_, dropped_, record_time_ns_, recorded_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+  };
+}
+#endif
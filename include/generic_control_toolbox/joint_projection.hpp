@@ -0,0 +1,73 @@
+#ifndef __JOINT_PROJECTION__
+#define __JOINT_PROJECTION__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+
+namespace generic_control_toolbox
+{
+  /**
+    Projects joint state messages onto a group of joints, e.g., the joints
+    of one arm in a robot which publishes the states of all its joints in a
+    single message. The index of each group joint in the input messages is
+    computed once, and only recomputed when the layout of the input changes,
+    so projecting a message costs a copy of the group joints. Joints missing
+    from an input layout are assumed to stay missing until the layout size
+    changes.
+  **/
+  class JointProjection
+  {
+  public:
+    JointProjection();
+    ~JointProjection();
+
+    /**
+      Sets the joint group.
+
+      @param joints The joints of the group, in the order of the projected messages.
+    **/
+    void setJoints(const std::vector<std::string> &joints);
+
+    /**
+      @return The joints of the group.
+    **/
+    const std::vector<std::string> &joints() const;
+
+    /**
+      @return True if the group has joints, false otherwise.
+    **/
+    bool isSet() const;
+
+    /**
+      Projects a message onto the joint group. The output holds the group
+      joints found in the input, in the group order, and the header of the
+      input. Allocation-free once the output has the size of the group and
+      the input layout is known.
+
+      @param in The message to project.
+      @param out The projected message.
+      @return True if all the group joints were found in the input, false otherwise.
+    **/
+    bool project(const sensor_msgs::JointState &in, sensor_msgs::JointState &out);
+
+  private:
+    /**
+      Computes the index of each group joint in the input layout.
+
+      @param in A message with the input layout.
+    **/
+    void buildIndex(const sensor_msgs::JointState &in);
+
+    /**
+      @param in The message to check.
+      @return True if the input layout matches the index, false otherwise.
+    **/
+    bool indexMatches(const sensor_msgs::JointState &in) const;
+
+    std::vector<std::string> joints_;
+    std::vector<int> index_; /// position of each group joint in the input, -1 if missing
+    unsigned long input_size_;
+    bool complete_;
+  };
+}
+#endif
@@ -0,0 +1,72 @@
+#ifndef __JOINT_STATE_ESTIMATOR__
+#define __JOINT_STATE_ESTIMATOR__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <Eigen/Dense>
+
+namespace generic_control_toolbox
+{
+  /**
+    Estimates the joint velocities and accelerations from the measured joint
+    positions with an alpha-beta-gamma filter, i.e., a steady-state Kalman
+    filter of a constant acceleration model. Each joint has a fixed-size
+    state of position, velocity and acceleration, and all joints are
+    filtered together with vectorized operations.
+
+    The gains trade off noise and lag: larger gains follow the measurements
+    more closely and smaller gains filter more. The accepted gains, which
+    are stable, satisfy 0 < alpha < 1, 0 < beta < 2 and
+    0 < gamma < 4*alpha*beta/(2 - alpha).
+  **/
+  class JointStateEstimator
+  {
+  public:
+    /**
+      @param alpha The position gain.
+      @param beta The velocity gain.
+      @param gamma The acceleration gain.
+    **/
+    JointStateEstimator(double alpha = 0.5, double beta = 0.1, double gamma = 0.01);
+    ~JointStateEstimator();
+
+    /**
+      Sets the filter gains.
+
+      @return False if the gains are not stable, true otherwise.
+    **/
+    bool setGains(double alpha, double beta, double gamma);
+
+    /**
+      Restarts the filter from the next measurement.
+    **/
+    void reset();
+
+    /**
+      Updates the filter with a joint state and replaces its velocities with
+      the estimated ones. The filter restarts if the number of joints
+      changes or the elapsed time is not valid. Allocation-free while the
+      number of joints does not change.
+
+      @param state The measured joint state, with the estimated velocities on return.
+      @param stamp The measurement time of the joint state.
+      @return False if the joint state has no positions, true otherwise.
+    **/
+    bool update(sensor_msgs::JointState &state, const ros::Time &stamp);
+
+    /**
+      @return The estimated joint positions, velocities and accelerations,
+      in the order of the last joint state.
+    **/
+    const Eigen::VectorXd &position() const;
+    const Eigen::VectorXd &velocity() const;
+    const Eigen::VectorXd &acceleration() const;
+
+  private:
+    Eigen::VectorXd position_, velocity_, acceleration_, residual_;
+    ros::Time last_stamp_;
+    double alpha_, beta_, gamma_;
+    bool initialized_;
+  };
+}
+#endif
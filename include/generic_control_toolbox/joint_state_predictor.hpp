@@ -0,0 +1,80 @@
+#ifndef __JOINT_STATE_PREDICTOR__
+#define __JOINT_STATE_PREDICTOR__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <Eigen/Dense>
+
+namespace generic_control_toolbox
+{
+  /**
+    Compensates the age of the joint state measurements by extrapolating
+    them to the time at which the controller command takes effect, i.e.,
+    the time of the control update plus an actuation delay, with the
+    velocities and accelerations of a JointStateEstimator.
+
+    Each prediction is kept until the measurements reach its time, and
+    compared to the measured positions interpolated at that time, so the
+    prediction error can be monitored while tuning the actuation delay and
+    the estimator gains.
+  **/
+  class JointStatePredictor
+  {
+  public:
+    /**
+      @param actuation_delay The time between the control update and the command taking effect, in seconds.
+      @param capacity The maximum number of predictions waiting for their measurements.
+    **/
+    JointStatePredictor(double actuation_delay = 0.0, unsigned int capacity = 64);
+    ~JointStatePredictor();
+
+    void setActuationDelay(double actuation_delay);
+    double actuationDelay() const;
+
+    /**
+      Extrapolates a joint state. Allocation-free while the number of joints
+      does not change.
+
+      @param state The measured joint state.
+      @param stamp The measurement time of the joint state.
+      @param velocity The estimated joint velocities.
+      @param acceleration The estimated joint accelerations.
+      @param now The time of the control update.
+      @param predicted The joint state predicted at now plus the actuation delay.
+      @return False if the estimates do not match the joint state, true otherwise.
+    **/
+    bool predict(const sensor_msgs::JointState &state, const ros::Time &stamp, const Eigen::VectorXd &velocity, const Eigen::VectorXd &acceleration, const ros::Time &now, sensor_msgs::JointState &predicted);
+
+    /**
+      Compares a new measurement to the predictions made for times up to
+      its stamp.
+
+      @param state The measured joint state.
+      @param stamp The measurement time of the joint state.
+    **/
+    void observe(const sensor_msgs::JointState &state, const ros::Time &stamp);
+
+    /**
+      Prediction error statistics since the last reset, over all joints, in
+      the units of the joint positions.
+    **/
+    unsigned long errorCount() const;
+    double rmsError() const;
+    double maxError() const;
+    void resetError();
+
+  private:
+    /**
+      Sizes the buffers for a number of joints and drops the pending predictions.
+    **/
+    void resize(unsigned long n);
+
+    Eigen::MatrixXd predictions_; /// one predicted position vector per column
+    std::vector<ros::Time> targets_;
+    Eigen::VectorXd last_measured_;
+    ros::Time last_stamp_;
+    unsigned long head_, size_, error_count_;
+    double actuation_delay_, squared_error_, max_error_;
+  };
+}
+#endif
@@ -17,6 +17,7 @@
 #include <kdl/kdl.hpp>
 #include <kdl/chaindynparam.hpp>
 #include <urdf/model.h>
+#include <generic_control_toolbox/robot_model_cache.hpp>
 #include <kdl/frames.hpp>
 #include <stdexcept>
 #include <generic_control_toolbox/manager_base.hpp>
@@ -230,6 +231,16 @@ namespace generic_control_toolbox
     **/
     bool getJointLimits(const std::string &end_effector_link, KDL::JntArray &q_min, KDL::JntArray &q_max, KDL::JntArray &q_vel_lim) const;
 
+    /**
+      Returns the names of the actuated joints in the eef kinematic chain,
+      ordered from the chain base link.
+
+      @param end_effector_link The name of the requested end-effector.
+      @param names The actuated joint names.
+      @return False in case something goes wrong, true otherwise.
+    **/
+    bool getActuatedJointNames(const std::string &end_effector_link, std::vector<std::string> &names) const;
+
     /**
       Returns the current joint positions in the KDL format.
 
@@ -291,9 +302,9 @@ namespace generic_control_toolbox
     std::vector<KDL::Chain> chain_;
     std::vector<KDL::ChainDynParam> dynamic_chain_;
 
-    urdf::Model model_;
+    std::shared_ptr<const urdf::Model> model_; /// shared through RobotModelCache
     ros::NodeHandle nh_;
-    tf::TransformListener listener_;
+    std::shared_ptr<tf::TransformListener> listener_;
     KDL::Vector gravity_in_chain_base_link_;
     std::vector<std::vector<std::string> > actuated_joint_names_; /// list of actuated joints per arm
     std::string chain_base_link_, ikvel_solver_;
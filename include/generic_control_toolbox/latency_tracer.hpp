@@ -0,0 +1,95 @@
+#ifndef __LATENCY_TRACER__
+#define __LATENCY_TRACER__
+
+#include <ros/ros.h>
+#include <generic_control_toolbox/timing_statistics.hpp>
+#include <generic_control_toolbox/LatencyStatistics.h>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <atomic>
+#include <thread>
+
+namespace generic_control_toolbox
+{
+  /**
+    Timestamps of one control cycle, from the measurement of the joint state
+    it consumes to the publication of the command.
+  **/
+  struct LatencyTrace
+  {
+    ros::Time stamp; /// header stamp of the joint state
+    ros::Time receive; /// reception time of the joint state
+    ros::Time cycle_start;
+    ros::Time update_end; /// end of the controller update
+    ros::Time publish;
+  };
+
+  /**
+    Breaks down the latency of the control loop into the driver and
+    transport (stamp to receive), queueing (receive to cycle start),
+    compute (cycle start to update end), publishing (update end to publish)
+    and total (stamp to publish) segments. The publish time is taken when the
+    command is actually published, i.e., by the RealtimeCommandPublisher
+    thread, or written to shared memory, or when it is handed to the
+    interpolating thread. Traces are handed over without locking from a
+    single thread, and a background thread computes and publishes the
+    percentiles of each segment.
+  **/
+  class LatencyTracer
+  {
+  public:
+    LatencyTracer();
+    ~LatencyTracer();
+
+    /**
+      Starts the statistics thread.
+
+      @param pub The publisher for generic_control_toolbox/LatencyStatistics messages.
+      @param period The period at which the statistics are published, in seconds.
+      @return False if the tracer is already running or the period is invalid, true otherwise.
+    **/
+    bool start(const ros::Publisher &pub, double period);
+
+    /**
+      Stops the statistics thread.
+    **/
+    void stop();
+
+    bool isRunning() const;
+
+    /**
+      Adds the trace of a control cycle. Lock-free and allocation-free.
+
+      @param trace The cycle trace.
+      @return False if the trace was dropped because the queue is full, true otherwise.
+    **/
+    bool trace(const LatencyTrace &trace);
+
+    /**
+      @return The number of traces dropped because the queue was full.
+    **/
+    unsigned long droppedTraces() const;
+
+  private:
+    enum Segment {TRANSPORT, QUEUEING, COMPUTE, PUBLISH, TOTAL, NUM_SEGMENTS};
+
+    /**
+      Accumulates the traces and publishes the statistics.
+    **/
+    void statisticsThread();
+
+    /**
+      Publishes the statistics of all segments.
+    **/
+    void publishStatistics();
+
+    boost::lockfree::spsc_queue<LatencyTrace, boost::lockfree::capacity<1024> > traces_;
+    std::vector<TimingStatistics> segments_;
+    generic_control_toolbox::LatencyStatistics msg_;
+    ros::Publisher pub_;
+    std::thread thread_;
+    std::atomic<bool> running_, stop_;
+    std::atomic<unsigned long> dropped_;
+    double period_;
+  };
+}
+#endif
@@ -0,0 +1,291 @@
+#ifndef __MULTI_RATE_CONTROLLER_TEMPLATE__
+#define __MULTI_RATE_CONTROLLER_TEMPLATE__
+
+#include <generic_control_toolbox/controller_template.hpp>
+#include <generic_control_toolbox/single_slot_buffer.hpp>
+#include <generic_control_toolbox/timing_statistics.hpp>
+#include <generic_control_toolbox/realtime_utils.hpp>
+
+namespace generic_control_toolbox
+{
+  /**
+    A controller template split into a slow planning part and a fast
+    feedback part. planningStep runs on its own thread at the
+    <action_name>/planning_rate parameter and computes a Reference, e.g., a
+    re-planned trajectory or an IK solution, which controlAlgorithm tracks at
+    the loop rate. The latest state and goal are handed to the planning
+    thread, and the references handed back, through wait-free buffers, so
+    the control thread never waits for the planner.
+
+    Offline, planningStep runs in the control thread at the planning rate,
+    so that replays are deterministic.
+  **/
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  class MultiRateControllerTemplate : public ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>
+  {
+  public:
+    MultiRateControllerTemplate(const std::string &action_name);
+
+    /**
+      Reads the parameters and serves the action server in the given
+      namespace, e.g., the private namespace of a nodelet.
+    **/
+    MultiRateControllerTemplate(const std::string &action_name, const ros::NodeHandle &nh);
+
+    /**
+      Constructs an offline controller, see ControllerTemplate.
+    **/
+    MultiRateControllerTemplate(const std::string &action_name, Offline offline);
+    virtual ~MultiRateControllerTemplate();
+
+    using ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult>::updateControl;
+
+    /**
+      Hands over the planning data and runs the control algorithm.
+    **/
+    virtual void updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command);
+
+    /**
+      Timing statistics of the control and planning threads, in seconds. Only
+      safe to read while the controller is not running.
+    **/
+    const TimingStatistics &controlTiming() const;
+    const TimingStatistics &planningTiming() const;
+
+  protected:
+    MultiRateControllerTemplate(const std::string &action_name, boost::shared_ptr<ros::NodeHandle> nh, bool offline = false);
+
+    /**
+      Implementation of the slow part of the control method, called by the
+      planning thread while the controller is active. Must not use data
+      modified by controlAlgorithm.
+
+      @param current_state The latest joint state given to the controller.
+      @param goal The goal being executed.
+      @param reference The reference to compute.
+      @return True if the reference was computed, false to keep the previous one.
+    **/
+    virtual bool planningStep(const sensor_msgs::JointState &current_state, boost::shared_ptr<const ActionGoal> goal, Reference &reference) = 0;
+
+    /**
+      @return True if planningStep computed a reference for the goal being executed.
+    **/
+    bool hasReference() const;
+
+    /**
+      @return The latest reference computed by planningStep.
+    **/
+    const Reference &reference() const;
+
+    /**
+      Stops the planning thread, and shuts the controller down, see
+      ControllerTemplate::shutdown. Controllers must call it in their
+      destructor, since planningStep and prepareGoal cannot run once they are
+      destroyed.
+    **/
+    void stopPlanning();
+
+  private:
+    typedef ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult> Base;
+
+    struct PlanningInput
+    {
+      sensor_msgs::JointState state;
+      boost::shared_ptr<const ActionGoal> goal;
+    };
+
+    struct PlanningOutput
+    {
+      Reference reference;
+      boost::shared_ptr<const ActionGoal> goal; /// the goal the reference was computed for, kept alive so that a new goal cannot reuse its address
+    };
+
+    /**
+      Runs planningStep at the planning rate.
+    **/
+    void planningThread();
+
+    /**
+      Runs planningStep and hands over the reference.
+
+      @param input The planning input.
+    **/
+    void plan(const PlanningInput &input);
+
+    SingleSlotBuffer<PlanningInput> input_buffer_;
+    SingleSlotBuffer<PlanningOutput> output_buffer_;
+    TimingStatistics control_timing_, planning_timing_;
+    std::thread planning_thread_;
+    std::atomic<bool> stop_planning_;
+    bool offline_;
+    int planning_priority_;
+    double planning_rate_, time_since_planning_;
+  };
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::MultiRateControllerTemplate(const std::string &action_name) : MultiRateControllerTemplate(action_name, boost::shared_ptr<ros::NodeHandle>()) {}
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::MultiRateControllerTemplate(const std::string &action_name, const ros::NodeHandle &nh) : MultiRateControllerTemplate(action_name, boost::shared_ptr<ros::NodeHandle>(new ros::NodeHandle(nh))) {}
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::MultiRateControllerTemplate(const std::string &action_name, Offline offline) : MultiRateControllerTemplate(action_name, boost::shared_ptr<ros::NodeHandle>(), true) {}
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::MultiRateControllerTemplate(const std::string &action_name, boost::shared_ptr<ros::NodeHandle> node_handle, bool offline) : Base(action_name, node_handle, offline), stop_planning_(false), offline_(offline), planning_priority_(0), planning_rate_(10), time_since_planning_(0.0)
+  {
+    output_buffer_.initialize(PlanningOutput());
+
+    if (offline_)
+    {
+      return;
+    }
+
+    ros::NodeHandle nh = node_handle ? *node_handle : ros::NodeHandle("~");
+    if (!nh.getParam(action_name + "/planning_rate", planning_rate_))
+    {
+      ROS_WARN("Missing %s/planning_rate parameter. Using default.", action_name.c_str());
+      planning_rate_ = 10;
+    }
+
+    if (planning_rate_ <= 0)
+    {
+      ROS_ERROR("%s/planning_rate must be positive. Using default.", action_name.c_str());
+      planning_rate_ = 10;
+    }
+
+    if (!nh.getParam(action_name + "/planning_priority", planning_priority_))
+    {
+      planning_priority_ = 0;
+    }
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::~MultiRateControllerTemplate()
+  {
+    stopPlanning();
+
+    if (control_timing_.count() > 0)
+    {
+      ROS_INFO_STREAM(control_timing_.summary("Control"));
+      ROS_INFO_STREAM(planning_timing_.summary("Planning"));
+    }
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  void MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (!offline_ && !planning_thread_.joinable() && !stop_planning_) // started here, once the controller is fully constructed
+    {
+      planning_thread_ = std::thread(&MultiRateControllerTemplate::planningThread, this);
+      if (planning_priority_ > 0)
+      {
+        setThreadPriority(planning_thread_, planning_priority_);
+      }
+    }
+
+    output_buffer_.update();
+    Base::updateControl(current_state, dt, command);
+
+    // hand over the inputs after the control update, which may have started a new goal
+    PlanningInput &input = input_buffer_.writeBuffer();
+    copyJointState(current_state, input.state);
+    input.goal = this->isActive() ? this->activeGoal() : boost::shared_ptr<const ActionGoal>();
+
+    if (offline_)
+    {
+      time_since_planning_ += dt.toSec();
+      if (input.goal && (time_since_planning_ >= 1.0/planning_rate_ || !hasReference()))
+      {
+        plan(input);
+        time_since_planning_ = 0.0;
+      }
+    }
+    else
+    {
+      input_buffer_.publish();
+    }
+
+    control_timing_.add(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  const TimingStatistics &MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::controlTiming() const
+  {
+    return control_timing_;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  const TimingStatistics &MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::planningTiming() const
+  {
+    return planning_timing_;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  bool MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::hasReference() const
+  {
+    const boost::shared_ptr<const ActionGoal> &goal = output_buffer_.readBuffer().goal;
+    return goal && goal == this->activeGoal();
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  const Reference &MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::reference() const
+  {
+    return output_buffer_.readBuffer().reference;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  void MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::stopPlanning()
+  {
+    stop_planning_ = true;
+    if (planning_thread_.joinable())
+    {
+      planning_thread_.join();
+    }
+
+    this->shutdown();
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  void MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::planningThread()
+  {
+    std::chrono::nanoseconds period(static_cast<long long>(1e9/planning_rate_));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    while (!stop_planning_)
+    {
+      input_buffer_.update();
+      if (input_buffer_.readBuffer().goal)
+      {
+        plan(input_buffer_.readBuffer());
+      }
+
+      next += period;
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      if (next < now) // overrun, do not try to catch up
+      {
+        next = now;
+      }
+
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult, class Reference>
+  void MultiRateControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult, Reference>::plan(const PlanningInput &input)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PlanningOutput &output = output_buffer_.writeBuffer();
+
+    if (planningStep(input.state, input.goal, output.reference))
+    {
+      output.goal = input.goal;
+      output_buffer_.publish();
+    }
+
+    planning_timing_.add(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+}
+#endif
@@ -0,0 +1,60 @@
+#ifndef __MULTI_ROBOT_ACTION_NODE__
+#define __MULTI_ROBOT_ACTION_NODE__
+
+#include <generic_control_toolbox/controller_action_node.hpp>
+#include <generic_control_toolbox/realtime_utils.hpp>
+#include <memory>
+#include <thread>
+
+namespace generic_control_toolbox
+{
+  /**
+    Hosts several robots in a single node. Each robot is a
+    ControllerActionNode with its parameters in the <name> namespace of the
+    node, e.g., <name>/loop_rate, <name>/joint_state_topic and
+    <name>/command_topic, and its own control thread. The thread runs with
+    the SCHED_FIFO priority given by the <name>/priority parameter and is
+    pinned to the CPU given by the <name>/cpu parameter, if set.
+
+    The robot descriptions and the TF listener are shared through
+    RobotModelCache, and the actionlib servers of all the controllers are
+    served by the main thread, so the controllers must have distinct action
+    names.
+  **/
+  class MultiRobotActionNode
+  {
+  public:
+    MultiRobotActionNode();
+    ~MultiRobotActionNode();
+
+    /**
+      Adds a robot to the node. Must be called before run.
+
+      @param name The robot name, which gives the namespace of its parameters.
+      @param controller The robot controller, which must outlive run.
+      @return False if the robot cannot be added, true otherwise.
+    **/
+    bool addRobot(const std::string &name, ControllerBase &controller);
+
+    /**
+      This blocking method runs the controllers of all robots until ROS
+      shuts down.
+    **/
+    void run();
+
+  private:
+    struct Robot
+    {
+      std::string name;
+      std::shared_ptr<ControllerActionNode> node;
+      ControllerBase *controller;
+      std::thread thread;
+      int priority, cpu;
+    };
+
+    ros::NodeHandle nh_;
+    std::vector<std::shared_ptr<Robot> > robots_;
+    bool running_;
+  };
+}
+#endif
@@ -0,0 +1,104 @@
+#ifndef __REALTIME_COMMAND_PUBLISHER__
+#define __REALTIME_COMMAND_PUBLISHER__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <generic_control_toolbox/single_slot_buffer.hpp>
+#include <generic_control_toolbox/latency_tracer.hpp>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace generic_control_toolbox
+{
+  /**
+    Publishes joint commands from a real-time thread. The control thread
+    copies each command into a preallocated slot without locking or
+    allocating, and a non real-time thread serializes and publishes the
+    latest command. Commands which are overwritten before being published
+    are counted as dropped, and commands published later than a given
+    latency are counted as late.
+  **/
+  class RealtimeCommandPublisher
+  {
+  public:
+    RealtimeCommandPublisher();
+    ~RealtimeCommandPublisher();
+
+    /**
+      Starts the publishing thread.
+
+      @param pub The publisher for the commands.
+      @param poll_rate The rate at which the publishing thread checks for new commands.
+      @param max_latency Commands published later than this, in seconds, are counted as late.
+      @param cpu The CPU the publishing thread is pinned to. Negative values do not pin it.
+      @param shared Whether to publish each command in a new message shared
+      pointer, which intra-process subscribers, e.g., nodelets, receive
+      without serialization.
+      @return False if something goes wrong, true otherwise.
+    **/
+    bool start(const ros::Publisher &pub, double poll_rate, double max_latency, int cpu, bool shared = false);
+
+    /**
+      Stops the publishing thread.
+    **/
+    void stop();
+
+    bool isRunning() const;
+
+    /**
+      Sets the tracer which receives the latency traces of the published
+      commands. Must be called before start.
+
+      @param tracer The latency tracer, or a null pointer to stop tracing.
+    **/
+    void setTracer(LatencyTracer *tracer);
+
+    /**
+      Hands a command over to the publishing thread. Lock-free and, once the
+      slots have the size of the command, allocation-free.
+
+      @param command The command to publish.
+    **/
+    void publish(const sensor_msgs::JointState &command);
+
+    /**
+      Hands a command over to the publishing thread, which completes its
+      latency trace with the time it is actually published and passes it to
+      the tracer. Commands which are overwritten before being published are
+      not traced.
+
+      @param command The command to publish.
+      @param trace The latency trace of the control cycle, up to the end of the controller update.
+    **/
+    void publish(const sensor_msgs::JointState &command, const LatencyTrace &trace);
+
+    unsigned long publishedCommands() const;
+    unsigned long droppedCommands() const;
+    unsigned long lateCommands() const;
+
+  private:
+    struct Command
+    {
+      sensor_msgs::JointState command;
+      std::chrono::steady_clock::time_point handoff;
+      LatencyTrace trace;
+      bool traced;
+    };
+
+    /**
+      Publishing thread loop.
+    **/
+    void publishingThread();
+
+    SingleSlotBuffer<Command> commands_;
+    ros::Publisher pub_;
+    LatencyTracer *tracer_;
+    std::thread thread_;
+    std::atomic<bool> stop_;
+    bool shared_;
+    std::atomic<unsigned long> published_, dropped_, late_;
+    double poll_period_, max_latency_;
+  };
+}
+#endif
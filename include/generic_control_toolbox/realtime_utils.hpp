@@ -0,0 +1,28 @@
+#ifndef __REALTIME_UTILS__
+#define __REALTIME_UTILS__
+
+#include <ros/ros.h>
+#include <thread>
+
+namespace generic_control_toolbox
+{
+  /**
+    Sets a thread to the SCHED_FIFO scheduling policy with the given priority.
+    Requires the process to have real-time scheduling permissions.
+
+    @param thread The thread to modify.
+    @param priority The SCHED_FIFO priority, between 1 and 99.
+    @return False if the priority could not be set, true otherwise.
+  **/
+  bool setThreadPriority(std::thread &thread, int priority);
+
+  /**
+    Pins a thread to a CPU.
+
+    @param thread The thread to modify.
+    @param cpu The CPU index.
+    @return False if the affinity could not be set, true otherwise.
+  **/
+  bool setThreadAffinity(std::thread &thread, int cpu);
+}
+#endif
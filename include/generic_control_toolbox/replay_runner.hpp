@@ -0,0 +1,294 @@
+#ifndef __REPLAY_RUNNER__
+#define __REPLAY_RUNNER__
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <actionlib_msgs/GoalID.h>
+#include <boost/function.hpp>
+#include <generic_control_toolbox/controller_template.hpp>
+#include <generic_control_toolbox/flight_record_reader.hpp>
+#include <generic_control_toolbox/timing_statistics.hpp>
+#include <cstdlib>
+#include <type_traits>
+
+namespace generic_control_toolbox
+{
+  /**
+    Replays a flight record through a controller, without ROS communication.
+    Each recorded joint state is given to the controller with the recorded
+    elapsed time, and the ROS clock is set to the recorded cycle time. Reports
+    the controller compute time of each step and the divergence between the
+    controller output and the recorded commands.
+  **/
+  class ReplayRunner
+  {
+  public:
+    ReplayRunner();
+    ~ReplayRunner();
+
+    /**
+      Opens the flight record to replay.
+
+      @param record_file The flight record file.
+      @return False if the record cannot be opened, true otherwise.
+    **/
+    bool open(const std::string &record_file);
+
+    /**
+      Sets a function called before each step with the recorded cycle time,
+      which gives the controller the goals due by then.
+
+      @param injector The goal injection function.
+    **/
+    void setGoalInjector(const boost::function<void (const ros::Time&)> &injector);
+
+    /**
+      Runs the controller through all the recorded cycles. Without a ROS
+      node, ros::Time::init must be called before, as the replay sets the
+      simulated time to the recorded one.
+
+      @param controller The controller to replay.
+      @param realtime If true, steps are paced by the recorded cycle times. Otherwise, they run as fast as possible.
+      @param csv_file If not empty, the per-step compute time and divergence are written to this file.
+      @return False if something goes wrong, true otherwise.
+    **/
+    bool run(ControllerBase &controller, bool realtime, const std::string &csv_file = "");
+
+    /**
+      @return The controller compute time statistics, in seconds.
+    **/
+    const TimingStatistics &computeTime() const;
+
+    /**
+      @return The maximum absolute difference between the replayed and recorded position commands.
+    **/
+    double maxPositionDivergence() const;
+
+    /**
+      @return The maximum absolute difference between the replayed and recorded velocity commands.
+    **/
+    double maxVelocityDivergence() const;
+
+    /**
+      @return A human-readable summary of the replay.
+    **/
+    std::string report() const;
+
+  private:
+    /**
+      Computes the maximum absolute difference between the finite values of
+      the replayed and recorded commands.
+    **/
+    double divergence(const std::vector<double> &replayed, const std::vector<double> &recorded) const;
+
+    FlightRecordReader reader_;
+    boost::function<void (const ros::Time&)> injector_;
+    TimingStatistics compute_time_;
+    double max_position_divergence_, max_velocity_divergence_;
+    uint64_t steps_;
+  };
+
+  /**
+    Injects the goals and cancel requests recorded in a rosbag (the
+    <action_ns>/goal and <action_ns>/cancel topics of the action server) into
+    an offline ControllerTemplate, at their recorded times.
+  **/
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  class BagGoalInjector
+  {
+  public:
+    typedef ControllerTemplate<ActionClass, ActionGoal, ActionFeedback, ActionResult> Controller;
+
+    BagGoalInjector(Controller &controller) : controller_(controller), next_(0) {}
+
+    /**
+      Loads the goal stream.
+
+      @param bag_file The rosbag file.
+      @param action_ns The action server namespace.
+      @return False if the bag cannot be read, true otherwise.
+    **/
+    bool load(const std::string &bag_file, const std::string &action_ns);
+
+    /**
+      Injects the goals and cancel requests recorded up to the given time.
+
+      @param time The current time.
+    **/
+    void inject(const ros::Time &time);
+
+  private:
+    typedef typename ActionClass::_action_goal_type ActionGoalMsg;
+
+    struct Event
+    {
+      ros::Time time;
+      boost::shared_ptr<const ActionGoal> goal; /// null for cancel requests
+    };
+
+    Controller &controller_;
+    std::vector<Event> events_;
+    unsigned long next_;
+  };
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  bool BagGoalInjector<ActionClass, ActionGoal, ActionFeedback, ActionResult>::load(const std::string &bag_file, const std::string &action_ns)
+  {
+    rosbag::Bag bag;
+    std::vector<std::string> topics;
+    topics.push_back(action_ns + "/goal");
+    topics.push_back(action_ns + "/cancel");
+
+    try
+    {
+      bag.open(bag_file, rosbag::bagmode::Read);
+      rosbag::View view(bag, rosbag::TopicQuery(topics));
+
+      for (rosbag::View::iterator it = view.begin(); it != view.end(); it++)
+      {
+        Event event;
+        event.time = it->getTime();
+
+        boost::shared_ptr<ActionGoalMsg> goal = it->template instantiate<ActionGoalMsg>();
+        if (goal)
+        {
+          event.goal = boost::shared_ptr<const ActionGoal>(goal, &goal->goal);
+          events_.push_back(event);
+          continue;
+        }
+
+        if (it->template instantiate<actionlib_msgs::GoalID>())
+        {
+          events_.push_back(event);
+        }
+      }
+
+      bag.close();
+    }
+    catch (const rosbag::BagException &e)
+    {
+      ROS_ERROR_STREAM("BagGoalInjector: failed to read " << bag_file << ": " << e.what());
+      return false;
+    }
+
+    ROS_INFO_STREAM("BagGoalInjector: loaded " << events_.size() << " goal events from " << bag_file);
+    next_ = 0;
+    return true;
+  }
+
+  template <class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  void BagGoalInjector<ActionClass, ActionGoal, ActionFeedback, ActionResult>::inject(const ros::Time &time)
+  {
+    while (next_ < events_.size() && events_[next_].time <= time)
+    {
+      if (events_[next_].goal)
+      {
+        controller_.injectGoal(events_[next_].goal);
+      }
+      else
+      {
+        controller_.cancelGoal();
+      }
+
+      next_++;
+    }
+  }
+
+  /**
+    Implements the main function of a replay executable for a controller
+    which derives from ControllerTemplate and has an offline constructor,
+    e.g., MyController(const std::string &action_name, Offline offline),
+    which forwards to the one of the template:
+
+      int main(int argc, char **argv)
+      {
+        return generic_control_toolbox::runReplay<MyController, ExampleAction, ExampleGoal, ExampleFeedback, ExampleResult>(argc, argv);
+      }
+
+    Usage: <executable> <flight record> <action name> [--goals <bag> <action namespace>] [--realtime] [--tolerance <value>] [--csv <file>]
+
+    The controller is constructed with OFFLINE, so no ROS master is needed
+    as long as the controller does not create node handles of its own. Returns
+    a non-zero exit code if the replay fails or the replayed commands diverge
+    from the recorded ones by more than the tolerance.
+  **/
+  template <class Controller, class ActionClass, class ActionGoal, class ActionFeedback, class ActionResult>
+  int runReplay(int argc, char **argv)
+  {
+    static_assert(std::is_constructible<Controller, const std::string&, Offline>::value, "runReplay needs a controller constructor taking (action_name, Offline)");
+
+    if (argc < 3)
+    {
+      std::cerr << "Usage: " << argv[0] << " <flight record> <action name> [--goals <bag> <action namespace>] [--realtime] [--tolerance <value>] [--csv <file>]" << std::endl;
+      return 1;
+    }
+
+    std::string record_file(argv[1]), action_name(argv[2]), bag_file, action_ns, csv_file;
+    bool realtime = false;
+    double tolerance = 1e-9;
+
+    for (int i = 3; i < argc; i++)
+    {
+      std::string arg(argv[i]);
+      if (arg == "--goals" && i + 2 < argc)
+      {
+        bag_file = argv[++i];
+        action_ns = argv[++i];
+      }
+      else if (arg == "--realtime")
+      {
+        realtime = true;
+      }
+      else if (arg == "--tolerance" && i + 1 < argc)
+      {
+        tolerance = atof(argv[++i]);
+      }
+      else if (arg == "--csv" && i + 1 < argc)
+      {
+        csv_file = argv[++i];
+      }
+      else
+      {
+        std::cerr << "Unknown argument " << arg << std::endl;
+        return 1;
+      }
+    }
+
+    ros::Time::init(); // there is no node, and ros::Time::now would throw
+    Controller controller(action_name, OFFLINE);
+    BagGoalInjector<ActionClass, ActionGoal, ActionFeedback, ActionResult> injector(controller);
+    ReplayRunner runner;
+
+    if (!runner.open(record_file))
+    {
+      return 1;
+    }
+
+    if (!bag_file.empty())
+    {
+      if (!injector.load(bag_file, action_ns))
+      {
+        return 1;
+      }
+
+      runner.setGoalInjector(boost::bind(&BagGoalInjector<ActionClass, ActionGoal, ActionFeedback, ActionResult>::inject, &injector, _1));
+    }
+
+    if (!runner.run(controller, realtime, csv_file))
+    {
+      return 1;
+    }
+
+    std::cout << runner.report() << std::endl;
+
+    if (runner.maxPositionDivergence() > tolerance || runner.maxVelocityDivergence() > tolerance)
+    {
+      std::cerr << "Replayed commands diverge from the recorded ones by more than " << tolerance << std::endl;
+      return 2;
+    }
+
+    return 0;
+  }
+}
+#endif
@@ -0,0 +1,45 @@
+#ifndef __ROBOT_MODEL_CACHE__
+#define __ROBOT_MODEL_CACHE__
+
+#include <ros/ros.h>
+#include <urdf/model.h>
+#include <tf/transform_listener.h>
+#include <memory>
+#include <mutex>
+#include <map>
+
+namespace generic_control_toolbox
+{
+  /**
+    Process-wide cache of the parsed robot descriptions and of a TF
+    listener. The managers and nodes of a process share them, so that each
+    robot description is parsed, and the TF topics are buffered, only once
+    even when the process controls several robots.
+  **/
+  class RobotModelCache
+  {
+  public:
+    /**
+      Gets a parsed robot description, parsing it on the first request.
+      Thread-safe.
+
+      @param param The robot description parameter.
+      @return The robot model, or an empty pointer if it cannot be loaded.
+    **/
+    static std::shared_ptr<const urdf::Model> getModel(const std::string &param = "/robot_description");
+
+    /**
+      Gets the TF listener of the process, created on the first request.
+      Thread-safe.
+
+      @return The TF listener.
+    **/
+    static std::shared_ptr<tf::TransformListener> getTransformListener();
+
+  private:
+    static std::mutex mutex_;
+    static std::map<std::string, std::shared_ptr<const urdf::Model> > models_;
+    static std::shared_ptr<tf::TransformListener> listener_;
+  };
+}
+#endif
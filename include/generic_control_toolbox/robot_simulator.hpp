@@ -0,0 +1,99 @@
+#ifndef __ROBOT_SIMULATOR__
+#define __ROBOT_SIMULATOR__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <generic_control_toolbox/kdl_manager.hpp>
+#include <Eigen/Dense>
+#include <deque>
+#include <random>
+#include <limits>
+
+namespace generic_control_toolbox
+{
+  /**
+    Lightweight robot stand-in for closed-loop tests. Simulates the joints
+    of the KDL chains given by the end_effectors parameter, integrating the
+    commands received on /joint_command and publishing the resulting
+    /joint_states at a fixed rate. Commands are interpreted according to the
+    command_mode parameter:
+
+      position: joints track the commanded positions, which are extrapolated
+                with the commanded velocities until the next command.
+      velocity: the commanded velocities are integrated.
+      effort: the commanded efforts are applied to the chain dynamics.
+
+    Command latency, measurement noise and dropped joint state messages can
+    be injected through parameters.
+  **/
+  class RobotSimulator
+  {
+  public:
+    RobotSimulator();
+    ~RobotSimulator();
+
+    /**
+      Loads the parameters and the robot kinematic chains.
+
+      @return False if something goes wrong, true otherwise.
+    **/
+    bool init();
+
+    /**
+      Runs the simulation loop until ROS shuts down.
+    **/
+    void run();
+
+  private:
+    enum CommandMode {POSITION, VELOCITY, EFFORT};
+
+    void commandCb(const sensor_msgs::JointState::ConstPtr &msg);
+
+    /**
+      Applies the commands whose latency has elapsed.
+
+      @param now The current time.
+    **/
+    void applyCommands(const ros::Time &now);
+
+    /**
+      Integrates the joint states.
+
+      @param dt The integration step.
+    **/
+    void step(double dt);
+
+    /**
+      Integrates the chain dynamics under the commanded efforts. The
+      accelerations of all the chains are computed from the same state, and
+      joints shared between chains are integrated once, with the mean of
+      their accelerations.
+
+      @param dt The integration step.
+    **/
+    void stepDynamics(double dt);
+
+    /**
+      Publishes the joint states, with noise and dropped messages.
+    **/
+    void publishState();
+
+    ros::NodeHandle nh_;
+    ros::Subscriber command_sub_;
+    ros::Publisher state_pub_;
+    std::shared_ptr<KDLManager> kdl_manager_;
+    std::vector<std::string> end_effectors_;
+    std::vector<std::vector<unsigned int> > chain_indices_; /// simulated joint index of each chain joint
+    std::map<std::string, unsigned int> joint_index_;
+    sensor_msgs::JointState state_, published_;
+    std::vector<double> q_min_, q_max_, command_position_, command_velocity_, command_effort_;
+    std::deque<sensor_msgs::JointState::ConstPtr> pending_commands_;
+    std::deque<ros::Time> pending_times_;
+    std::default_random_engine generator_;
+    std::normal_distribution<double> noise_;
+    std::uniform_real_distribution<double> uniform_;
+    CommandMode command_mode_;
+    double rate_, latency_, position_noise_, velocity_noise_, drop_probability_, damping_;
+  };
+}
+#endif
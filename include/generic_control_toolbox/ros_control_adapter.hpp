@@ -0,0 +1,219 @@
+#ifndef __ROS_CONTROL_ADAPTER__
+#define __ROS_CONTROL_ADAPTER__
+
+#include <ros/ros.h>
+#include <controller_interface/controller.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <sensor_msgs/JointState.h>
+#include <generic_control_toolbox/controller_template.hpp>
+#include <type_traits>
+
+namespace generic_control_toolbox
+{
+  /**
+    Selects the field of the controller output which is written to the joint
+    handles of a hardware interface, checks that the controller filled it
+    in, and gives the command which holds the joint in place.
+  **/
+  template <class HardwareInterface>
+  struct CommandField;
+
+  template <>
+  struct CommandField<hardware_interface::PositionJointInterface>
+  {
+    static bool valid(const sensor_msgs::JointState &command) { return command.position.size() == command.name.size(); }
+    static double get(const sensor_msgs::JointState &command, unsigned int i) { return command.position[i]; }
+    static double hold(const hardware_interface::JointHandle &joint) { return joint.getPosition(); }
+  };
+
+  template <>
+  struct CommandField<hardware_interface::VelocityJointInterface>
+  {
+    static bool valid(const sensor_msgs::JointState &command) { return command.velocity.size() == command.name.size(); }
+    static double get(const sensor_msgs::JointState &command, unsigned int i) { return command.velocity[i]; }
+    static double hold(const hardware_interface::JointHandle &joint) { return 0.0; }
+  };
+
+  template <>
+  struct CommandField<hardware_interface::EffortJointInterface>
+  {
+    static bool valid(const sensor_msgs::JointState &command) { return command.effort.size() == command.name.size(); }
+    static double get(const sensor_msgs::JointState &command, unsigned int i) { return command.effort[i]; }
+    static double hold(const hardware_interface::JointHandle &joint) { return 0.0; }
+  };
+
+  /**
+    Runs a ControllerBase implementation as a ros_control controller. The
+    joint states are read from, and the commands written to, the hardware
+    interface joint handles inside the controller_manager real-time loop,
+    without going through ROS topics.
+
+    The controller is constructed with the action name given by the
+    action_name parameter, and the joints are given by the joints parameter,
+    both in the ros_control controller namespace. Controllers which take a
+    node handle are constructed in that namespace too, so their parameters and
+    action server are next to the ros_control ones. The actionlib callbacks of
+    a ControllerTemplate are served by its own background thread, outside of
+    the real-time loop.
+
+    Since pluginlib requires concrete classes, the adapter must be exported
+    by the package which implements the controller, e.g.,
+
+      PLUGINLIB_EXPORT_CLASS(generic_control_toolbox::RosControlAdapter<MyController, hardware_interface::VelocityJointInterface>, controller_interface::ControllerBase)
+  **/
+  template <class Controller, class HardwareInterface>
+  class RosControlAdapter : public controller_interface::Controller<HardwareInterface>
+  {
+  public:
+    RosControlAdapter();
+    virtual ~RosControlAdapter();
+
+    bool init(HardwareInterface *hw, ros::NodeHandle &nh);
+    void starting(const ros::Time &time);
+    void update(const ros::Time &time, const ros::Duration &period);
+    void stopping(const ros::Time &time);
+
+  private:
+    /**
+      Constructs the controller in the ros_control controller namespace, if it
+      supports it.
+    **/
+    template <class C>
+    static typename std::enable_if<std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type createController(const std::string &action_name, const ros::NodeHandle &nh);
+
+    /**
+      Constructs the controller in the namespace of the controller_manager.
+    **/
+    template <class C>
+    static typename std::enable_if<!std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type createController(const std::string &action_name, const ros::NodeHandle &nh);
+
+    BasePtr controller_;
+    std::vector<hardware_interface::JointHandle> joints_;
+    sensor_msgs::JointState state_, command_;
+    bool was_running_;
+  };
+
+  template <class Controller, class HardwareInterface>
+  RosControlAdapter<Controller, HardwareInterface>::RosControlAdapter() : was_running_(false) {}
+
+  template <class Controller, class HardwareInterface>
+  RosControlAdapter<Controller, HardwareInterface>::~RosControlAdapter() {}
+
+  template <class Controller, class HardwareInterface>
+  bool RosControlAdapter<Controller, HardwareInterface>::init(HardwareInterface *hw, ros::NodeHandle &nh)
+  {
+    std::vector<std::string> joint_names;
+    std::string action_name;
+
+    if (!nh.getParam("joints", joint_names))
+    {
+      ROS_ERROR_STREAM("Missing joints parameter in " << nh.getNamespace());
+      return false;
+    }
+
+    if (!nh.getParam("action_name", action_name))
+    {
+      ROS_ERROR_STREAM("Missing action_name parameter in " << nh.getNamespace());
+      return false;
+    }
+
+    for (unsigned long i = 0; i < joint_names.size(); i++)
+    {
+      try
+      {
+        joints_.push_back(hw->getHandle(joint_names[i]));
+      }
+      catch (const hardware_interface::HardwareInterfaceException &e)
+      {
+        ROS_ERROR_STREAM("RosControlAdapter: " << e.what());
+        return false;
+      }
+    }
+
+    // preallocate the messages exchanged with the controller
+    state_.name = joint_names;
+    state_.position.resize(joint_names.size(), 0.0);
+    state_.velocity.resize(joint_names.size(), 0.0);
+    state_.effort.resize(joint_names.size(), 0.0);
+    command_ = state_;
+
+    controller_ = BasePtr(createController<Controller>(action_name, nh));
+    return true;
+  }
+
+  template <class Controller, class HardwareInterface>
+  void RosControlAdapter<Controller, HardwareInterface>::starting(const ros::Time &time)
+  {
+    for (unsigned long i = 0; i < joints_.size(); i++)
+    {
+      joints_[i].setCommand(CommandField<HardwareInterface>::hold(joints_[i]));
+    }
+
+    controller_->resetInternalState();
+    was_running_ = false;
+  }
+
+  template <class Controller, class HardwareInterface>
+  void RosControlAdapter<Controller, HardwareInterface>::update(const ros::Time &time, const ros::Duration &period)
+  {
+    state_.header.stamp = time;
+    for (unsigned long i = 0; i < joints_.size(); i++)
+    {
+      state_.position[i] = joints_[i].getPosition();
+      state_.velocity[i] = joints_[i].getVelocity();
+      state_.effort[i] = joints_[i].getEffort();
+    }
+
+    controller_->updateControl(state_, period, command_);
+
+    bool active = controller_->isActive();
+    if (!active && !was_running_)
+    {
+      return;
+    }
+
+    was_running_ = active; // write the last command after the controller stops
+
+    if (command_.name != state_.name || !CommandField<HardwareInterface>::valid(command_))
+    {
+      ROS_ERROR_THROTTLE(10, "RosControlAdapter: the controller command does not match the controlled joints, holding them");
+      for (unsigned long i = 0; i < joints_.size(); i++)
+      {
+        joints_[i].setCommand(CommandField<HardwareInterface>::hold(joints_[i]));
+      }
+
+      return;
+    }
+
+    for (unsigned long i = 0; i < joints_.size(); i++)
+    {
+      joints_[i].setCommand(CommandField<HardwareInterface>::get(command_, i));
+    }
+  }
+
+  template <class Controller, class HardwareInterface>
+  void RosControlAdapter<Controller, HardwareInterface>::stopping(const ros::Time &time)
+  {
+    if (controller_->isActive())
+    {
+      controller_->abortControl();
+    }
+  }
+
+  template <class Controller, class HardwareInterface>
+  template <class C>
+  typename std::enable_if<std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type RosControlAdapter<Controller, HardwareInterface>::createController(const std::string &action_name, const ros::NodeHandle &nh)
+  {
+    return new C(action_name, nh);
+  }
+
+  template <class Controller, class HardwareInterface>
+  template <class C>
+  typename std::enable_if<!std::is_constructible<C, const std::string&, const ros::NodeHandle&>::value, C*>::type RosControlAdapter<Controller, HardwareInterface>::createController(const std::string &action_name, const ros::NodeHandle &nh)
+  {
+    ROS_WARN("The controller of %s does not take a node handle, its parameters and action server are in the namespace of the controller_manager", nh.getNamespace().c_str());
+    return new C(action_name);
+  }
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef __SHM_TRANSPORT__
+#define __SHM_TRANSPORT__
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <atomic>
+#include <stdint.h>
+
+namespace generic_control_toolbox
+{
+  /**
+    Shared memory joint state transport for processes on the same host. A
+    topic maps to the POSIX shared memory object /gct<topic>, with the
+    slashes of the topic replaced by underscores, which holds a
+    ShmTransportHeader, followed by num_joints null-padded joint names of
+    SHM_TRANSPORT_NAME_LENGTH characters, followed by a ring of capacity
+    records:
+
+      uint64 seq              odd while the record is being written
+      int64 stamp             header stamp, in nanoseconds
+      uint64 fields           mask of the fields the state has, see SHM_TRANSPORT_POSITION
+      float64 position[num_joints]
+      float64 velocity[num_joints]
+      float64 effort[num_joints]
+
+    The writer creates the object and fixes the layout, i.e., the joint names
+    and their order, and readers adopt it when they open the topic. Each
+    record is protected by a seqlock, so the writer never waits for the
+    readers and readers retry if a record changes while they copy it.
+  **/
+  const char SHM_TRANSPORT_MAGIC[8] = {'G', 'C', 'T', 'S', 'H', 'M', '\0', '\0'};
+  const uint32_t SHM_TRANSPORT_VERSION = 2;
+  const uint32_t SHM_TRANSPORT_NAME_LENGTH = 64;
+  const unsigned int SHM_TRANSPORT_MAX_READ_ATTEMPTS = 16;
+  const uint64_t SHM_TRANSPORT_POSITION = 1, SHM_TRANSPORT_VELOCITY = 2, SHM_TRANSPORT_EFFORT = 4; /// record field mask bits
+
+  struct ShmTransportHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_joints;
+    uint32_t capacity;
+    uint32_t name_length;
+    uint64_t record_bytes;
+    std::atomic<uint64_t> head; /// number of records written
+    std::atomic<uint32_t> closed; /// set when the writer closes the topic
+  };
+
+  /**
+    Base class of the shared memory writer and reader, which maps the
+    shared memory object of a topic.
+  **/
+  class ShmTransport
+  {
+  public:
+    ShmTransport();
+    virtual ~ShmTransport();
+
+    /**
+      Unmaps the shared memory object.
+    **/
+    virtual void close();
+
+    bool isOpen() const;
+
+    /**
+      @return The joint names of the topic layout.
+    **/
+    const std::vector<std::string> &jointNames() const;
+
+  protected:
+    /**
+      @param topic The topic name.
+      @return The name of the shared memory object of the topic.
+    **/
+    static std::string objectName(const std::string &topic);
+
+    /**
+      Maps the shared memory object.
+
+      @param fd The file descriptor of the shared memory object.
+      @param bytes The size of the object.
+      @param writable Whether to map it for writing.
+      @return False if something goes wrong, true otherwise.
+    **/
+    bool map(int fd, uint64_t bytes, bool writable);
+
+    /**
+      @param i The record index.
+      @return The sequence number of the record.
+    **/
+    std::atomic<uint64_t> &recordSeq(uint64_t i) const;
+
+    /**
+      @param i The record index.
+      @return The data of the record, i.e., the stamp and field mask followed by the joint values.
+    **/
+    char *recordData(uint64_t i) const;
+
+    std::string object_name_;
+    std::vector<std::string> names_;
+    ShmTransportHeader *header_;
+    char *records_;
+    uint64_t bytes_, record_bytes_;
+    unsigned int num_joints_, capacity_;
+  };
+
+  /**
+    Writes joint states to a shared memory topic.
+  **/
+  class ShmJointStateWriter : public ShmTransport
+  {
+  public:
+    ShmJointStateWriter();
+    virtual ~ShmJointStateWriter();
+
+    /**
+      Creates the shared memory object of a topic, replacing any previous
+      one.
+
+      @param topic The topic name.
+      @param joint_names The joints of the layout, in the order of the written states.
+      @param capacity The number of records in the ring.
+      @return False if something goes wrong, true otherwise.
+    **/
+    bool open(const std::string &topic, const std::vector<std::string> &joint_names, unsigned int capacity = 16);
+
+    /**
+      Marks the topic as closed and removes the shared memory object.
+    **/
+    virtual void close();
+
+    /**
+      Writes a joint state. Lock-free and allocation-free. Fields which do
+      not have a value for each joint, e.g., the positions of a velocity
+      command, are marked as missing.
+
+      @param state The joint state, with the joint names of the layout, in the same order.
+      @return False if the state does not match the layout, true otherwise.
+    **/
+    bool write(const sensor_msgs::JointState &state);
+  };
+
+  /**
+    Reads the latest joint state from a shared memory topic.
+  **/
+  class ShmJointStateReader : public ShmTransport
+  {
+  public:
+    ShmJointStateReader();
+    virtual ~ShmJointStateReader();
+
+    /**
+      Opens the shared memory object of a topic and reads its layout.
+
+      @param topic The topic name.
+      @return False if the topic does not exist or has an invalid layout, true otherwise.
+    **/
+    bool open(const std::string &topic);
+
+    /**
+      @return True if the writer closed the topic, false otherwise.
+    **/
+    bool writerClosed() const;
+
+    /**
+      Reads the latest joint state, if it was not read yet. Lock-free, and
+      allocation-free once the state has the size of the layout. The fields
+      the writer marked as missing are cleared.
+
+      @param state The joint state.
+      @return True if a new state was read, false otherwise.
+    **/
+    bool read(sensor_msgs::JointState &state);
+
+  private:
+    uint64_t last_head_;
+  };
+}
+#endif
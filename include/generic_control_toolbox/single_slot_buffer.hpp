@@ -0,0 +1,113 @@
+#ifndef __SINGLE_SLOT_BUFFER__
+#define __SINGLE_SLOT_BUFFER__
+
+#include <atomic>
+
+namespace generic_control_toolbox
+{
+  /**
+    Lock-free single slot buffer for passing the latest value of T from one
+    writer thread to one reader thread. Implemented as a triple buffer: the
+    writer and the reader each own a slot and exchange it with a shared middle
+    slot through a single atomic operation, so neither of them ever blocks or
+    waits for the other. Intermediate values are overwritten if the reader
+    is slower than the writer.
+
+    Neither side allocates memory as long as copying T into a slot does not,
+    which can be ensured by initializing the buffer with a value of the
+    expected size.
+  **/
+  template <class T>
+  class SingleSlotBuffer
+  {
+  public:
+    SingleSlotBuffer() : middle_(1), back_(0), front_(2) {}
+
+    /**
+      Initializes all slots with the given value. Not thread-safe, must be
+      called before the buffer is shared.
+
+      @param value The initial value.
+    **/
+    void initialize(const T &value)
+    {
+      for (unsigned int i = 0; i < 3; i++)
+      {
+        slots_[i] = value;
+      }
+
+      middle_.store(1);
+      back_ = 0;
+      front_ = 2;
+    }
+
+    /**
+      Writer side. Gives access to the slot owned by the writer, which is only
+      shared with the reader after calling publish.
+
+      @return The writer slot.
+    **/
+    T &writeBuffer()
+    {
+      return slots_[back_];
+    }
+
+    /**
+      Writer side. Makes the writer slot available to the reader.
+
+      @return True if a value that was not read yet got overwritten.
+    **/
+    bool publish()
+    {
+      unsigned int previous = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel);
+      back_ = previous & INDEX;
+      return (previous & DIRTY) != 0;
+    }
+
+    /**
+      Writer side. Copies a value into the writer slot and publishes it.
+
+      @param value The new value.
+      @return True if a value that was not read yet got overwritten.
+    **/
+    bool write(const T &value)
+    {
+      slots_[back_] = value;
+      return publish();
+    }
+
+    /**
+      Reader side. Acquires the latest published value, if there is one.
+
+      @return True if a new value is available in readBuffer.
+    **/
+    bool update()
+    {
+      if ((middle_.load(std::memory_order_acquire) & DIRTY) == 0)
+      {
+        return false;
+      }
+
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+      return true;
+    }
+
+    /**
+      Reader side. Gives access to the last value acquired with update.
+
+      @return The reader slot.
+    **/
+    const T &readBuffer() const
+    {
+      return slots_[front_];
+    }
+
+  private:
+    static const unsigned int INDEX = 3, DIRTY = 4;
+
+    T slots_[3];
+    std::atomic<unsigned int> middle_; /// index of the shared slot, flagged with DIRTY when it holds an unread value
+    unsigned int back_, front_; /// writer and reader slots
+  };
+}
+#endif
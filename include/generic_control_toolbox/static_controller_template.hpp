@@ -0,0 +1,394 @@
+#ifndef __STATIC_CONTROLLER_TEMPLATE__
+#define __STATIC_CONTROLLER_TEMPLATE__
+
+#include <generic_control_toolbox/controller_template.hpp>
+#include <Eigen/Dense>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace generic_control_toolbox
+{
+  /**
+    Controller template for small high-rate controllers, e.g., joint
+    impedance controllers running at several kHz. The number of joints is a
+    compile-time constant, the joint states and commands are fixed-size Eigen
+    vectors, and the controller is called through the curiously recurring
+    template pattern instead of virtual methods, so the compiler can inline
+    the whole control step.
+
+    Derived classes inherit from StaticControllerTemplate<Derived, DOF> and
+    implement
+
+      bool isActive() const;
+      void controlAlgorithm(const State &state, double dt, Command &command);
+      void resetController();
+
+    Unlike ControllerTemplate, there is no actionlib server: the controller
+    receives its setpoints through its own interface, e.g., a
+    SingleSlotBuffer written by another thread. Derived classes with
+    fixed-size Eigen members must use EIGEN_MAKE_ALIGNED_OPERATOR_NEW.
+  **/
+  template <class Derived, int DOF>
+  class StaticControllerTemplate
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    static const int dof = DOF;
+    typedef Eigen::Matrix<double, DOF, 1> JointVector;
+
+    struct State
+    {
+      EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+      JointVector position, velocity, effort;
+    };
+
+    typedef State Command;
+
+    StaticControllerTemplate();
+
+    /**
+      Computes the command for the current joint state. While the controller
+      is not active, or if the elapsed time or the command are invalid, the
+      command holds the joint positions.
+
+      @param state The current joint state.
+      @param dt The time elapsed since the last update, in seconds.
+      @param command The joint command.
+    **/
+    void update(const State &state, double dt, Command &command);
+
+    /**
+      Resets the controller and the held command.
+    **/
+    void reset();
+
+    /**
+      Gives the controller the last command of the controller it replaces,
+      which is held until it becomes active.
+
+      @param command The last command of the outgoing controller.
+    **/
+    void seed(const Command &command);
+
+  protected:
+    /**
+      @return The last command computed by controlAlgorithm, or the held command.
+    **/
+    const Command &lastCommand() const;
+
+  private:
+    Derived &derived();
+    const Derived &derived() const;
+
+    /**
+      Sets the command to hold the joint positions of the state given when
+      the hold started.
+
+      @param state The current joint state.
+      @param command The joint command.
+    **/
+    void hold(const State &state, Command &command);
+
+    Command last_command_;
+    bool holding_, has_command_;
+  };
+
+  /**
+    Runs a StaticControllerTemplate implementation through the ControllerBase
+    interface, e.g., in a ControllerActionNode or a RosControlAdapter. The
+    joint states are mapped to the fixed-size state through an index map,
+    which is only recomputed when the layout of the joint state messages
+    changes, and the commands hold the controlled joints only.
+  **/
+  template <class Controller>
+  class StaticControllerAdapter : public ControllerBase
+  {
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    /**
+      @param joints The names of the controlled joints, in the controller order.
+      @param args The arguments of the controller constructor.
+      @throw invalid_argument in case joints does not have Controller::dof names.
+    **/
+    template <class... Args>
+    StaticControllerAdapter(const std::vector<std::string> &joints, Args&&... args);
+    virtual ~StaticControllerAdapter();
+
+    virtual sensor_msgs::JointState updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt);
+    virtual void updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command);
+    virtual bool isActive() const;
+    virtual void resetInternalState();
+    virtual void seedCommand(const sensor_msgs::JointState &command);
+
+    /**
+      @return The wrapped controller.
+    **/
+    Controller &controller();
+
+  private:
+    typedef typename Controller::State State;
+    typedef typename Controller::Command Command;
+
+    /**
+      Maps a joint state message to the fixed-size state.
+
+      @param msg The joint state message.
+      @param state The fixed-size state.
+      @return False if the message does not have the positions of all the
+      controlled joints, true otherwise. Missing velocities and efforts are
+      taken as zero.
+    **/
+    bool toState(const sensor_msgs::JointState &msg, State &state);
+
+    Controller controller_;
+    std::vector<std::string> joints_;
+    int index_[Controller::dof]; /// position of each controlled joint in the messages
+    unsigned long layout_size_;
+    bool has_state_; /// whether a valid state was received, so that there is a command to hold
+    State state_;
+    Command command_;
+  };
+
+  template <class Derived, int DOF>
+  StaticControllerTemplate<Derived, DOF>::StaticControllerTemplate() : holding_(false), has_command_(false)
+  {
+    last_command_.position.setZero();
+    last_command_.velocity.setZero();
+    last_command_.effort.setZero();
+  }
+
+  template <class Derived, int DOF>
+  inline void StaticControllerTemplate<Derived, DOF>::update(const State &state, double dt, Command &command)
+  {
+    if (!derived().isActive())
+    {
+      hold(state, command);
+      return;
+    }
+
+    if (dt <= 0 || dt > MAX_DT)
+    {
+      ROS_ERROR_THROTTLE(1, "StaticControllerTemplate: invalid elapsed time of %.3f seconds, resetting", dt);
+      reset();
+      hold(state, command);
+      return;
+    }
+
+    derived().controlAlgorithm(state, dt, command);
+
+    if (!command.position.allFinite() || !command.velocity.allFinite() || !command.effort.allFinite())
+    {
+      ROS_ERROR_THROTTLE(1, "StaticControllerTemplate: invalid command, resetting");
+      reset();
+      hold(state, command);
+      return;
+    }
+
+    last_command_ = command;
+    holding_ = false;
+    has_command_ = true;
+  }
+
+  template <class Derived, int DOF>
+  void StaticControllerTemplate<Derived, DOF>::reset()
+  {
+    derived().resetController();
+    holding_ = false;
+  }
+
+  template <class Derived, int DOF>
+  void StaticControllerTemplate<Derived, DOF>::seed(const Command &command)
+  {
+    last_command_ = command;
+    last_command_.velocity.setZero();
+    holding_ = true;
+    has_command_ = true;
+  }
+
+  template <class Derived, int DOF>
+  const typename StaticControllerTemplate<Derived, DOF>::Command &StaticControllerTemplate<Derived, DOF>::lastCommand() const
+  {
+    return last_command_;
+  }
+
+  template <class Derived, int DOF>
+  inline Derived &StaticControllerTemplate<Derived, DOF>::derived()
+  {
+    return *static_cast<Derived*>(this);
+  }
+
+  template <class Derived, int DOF>
+  inline const Derived &StaticControllerTemplate<Derived, DOF>::derived() const
+  {
+    return *static_cast<const Derived*>(this);
+  }
+
+  template <class Derived, int DOF>
+  inline void StaticControllerTemplate<Derived, DOF>::hold(const State &state, Command &command)
+  {
+    if (!holding_)
+    {
+      last_command_.position = has_command_ ? last_command_.position : state.position;
+      last_command_.velocity.setZero();
+      last_command_.effort.setZero();
+      holding_ = true;
+      has_command_ = true;
+    }
+
+    command = last_command_;
+  }
+
+  template <class Controller>
+  template <class... Args>
+  StaticControllerAdapter<Controller>::StaticControllerAdapter(const std::vector<std::string> &joints, Args&&... args) : controller_(std::forward<Args>(args)...), joints_(joints), layout_size_(0), has_state_(false)
+  {
+    if (joints_.size() != static_cast<unsigned long>(Controller::dof))
+    {
+      std::stringstream errMsg;
+      errMsg << "StaticControllerAdapter: got " << joints_.size() << " joints for a controller of " << Controller::dof << " joints";
+      throw std::invalid_argument(errMsg.str());
+    }
+
+    for (int i = 0; i < Controller::dof; i++)
+    {
+      index_[i] = -1;
+    }
+
+    state_.position.setZero();
+    state_.velocity.setZero();
+    state_.effort.setZero();
+    command_ = state_;
+  }
+
+  template <class Controller>
+  StaticControllerAdapter<Controller>::~StaticControllerAdapter() {}
+
+  template <class Controller>
+  sensor_msgs::JointState StaticControllerAdapter<Controller>::updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt)
+  {
+    sensor_msgs::JointState ret;
+    updateControl(current_state, dt, ret);
+    return ret;
+  }
+
+  template <class Controller>
+  void StaticControllerAdapter<Controller>::updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command)
+  {
+    if (toState(current_state, state_))
+    {
+      has_state_ = true;
+    }
+    else
+    {
+      ROS_ERROR_THROTTLE(10, "StaticControllerAdapter: the joint states do not include the positions of all the controlled joints");
+      controller_.reset();
+
+      if (!has_state_) // nothing to hold yet
+      {
+        command.header = current_state.header;
+        command.name.clear();
+        command.position.clear();
+        command.velocity.clear();
+        command.effort.clear();
+        return;
+      }
+
+      state_.position = command_.position; // hold the last command
+    }
+
+    controller_.update(state_, dt.toSec(), command_);
+
+    command.header = current_state.header;
+    if (command.name != joints_)
+    {
+      command.name = joints_;
+    }
+
+    command.position.resize(Controller::dof);
+    command.velocity.resize(Controller::dof);
+    command.effort.resize(Controller::dof);
+    Eigen::Map<typename Controller::JointVector>(command.position.data()) = command_.position;
+    Eigen::Map<typename Controller::JointVector>(command.velocity.data()) = command_.velocity;
+    Eigen::Map<typename Controller::JointVector>(command.effort.data()) = command_.effort;
+  }
+
+  template <class Controller>
+  bool StaticControllerAdapter<Controller>::isActive() const
+  {
+    return controller_.isActive();
+  }
+
+  template <class Controller>
+  void StaticControllerAdapter<Controller>::resetInternalState()
+  {
+    controller_.reset();
+  }
+
+  template <class Controller>
+  void StaticControllerAdapter<Controller>::seedCommand(const sensor_msgs::JointState &command)
+  {
+    Command seed;
+    if (toState(command, seed))
+    {
+      controller_.seed(seed);
+    }
+  }
+
+  template <class Controller>
+  Controller &StaticControllerAdapter<Controller>::controller()
+  {
+    return controller_;
+  }
+
+  template <class Controller>
+  bool StaticControllerAdapter<Controller>::toState(const sensor_msgs::JointState &msg, State &state)
+  {
+    unsigned long n = msg.name.size();
+    if (msg.position.size() != n)
+    {
+      return false;
+    }
+
+    bool valid = n == layout_size_;
+    for (int i = 0; valid && i < Controller::dof; i++)
+    {
+      valid = index_[i] >= 0 && msg.name[index_[i]] == joints_[i];
+    }
+
+    if (!valid) // new layout
+    {
+      layout_size_ = n;
+      for (int i = 0; i < Controller::dof; i++)
+      {
+        index_[i] = -1;
+        for (unsigned long j = 0; j < n; j++)
+        {
+          if (msg.name[j] == joints_[i])
+          {
+            index_[i] = j;
+            break;
+          }
+        }
+
+        if (index_[i] < 0)
+        {
+          layout_size_ = 0; // retry with the next message
+          return false;
+        }
+      }
+    }
+
+    for (int i = 0; i < Controller::dof; i++)
+    {
+      state.position[i] = msg.position[index_[i]];
+      state.velocity[i] = msg.velocity.size() == n ? msg.velocity[index_[i]] : 0.0;
+      state.effort[i] = msg.effort.size() == n ? msg.effort[index_[i]] : 0.0;
+    }
+
+    return true;
+  }
+}
+#endif
@@ -0,0 +1,63 @@
+#ifndef __TIMING_STATISTICS__
+#define __TIMING_STATISTICS__
+
+#include <vector>
+#include <string>
+
+namespace generic_control_toolbox
+{
+  /**
+    Accumulates timing samples. The count, mean and maximum are kept over all
+    samples, and the percentiles are computed over a window with the most
+    recent samples. Adding samples does not allocate memory. Not thread-safe.
+  **/
+  class TimingStatistics
+  {
+  public:
+    /**
+      @param window The number of recent samples kept for the percentiles.
+    **/
+    TimingStatistics(unsigned int window = 10000);
+    ~TimingStatistics();
+
+    /**
+      Removes all samples.
+    **/
+    void reset();
+
+    /**
+      Adds a sample.
+
+      @param sample The new sample.
+    **/
+    void add(double sample);
+
+    unsigned long count() const;
+    double mean() const;
+    double max() const;
+
+    /**
+      Computes a percentile of the samples in the window. Allocates memory
+      on the first call, should not be called from a real-time thread.
+
+      @param p The percentile, between 0 and 100.
+      @return The percentile, or 0 if there are no samples.
+    **/
+    double percentile(double p) const;
+
+    /**
+      Formats the statistics in a human-readable string, in microseconds.
+
+      @param name Name prepended to the string.
+      @return The statistics summary.
+    **/
+    std::string summary(const std::string &name) const;
+
+  private:
+    std::vector<double> samples_;
+    mutable std::vector<double> sorted_;
+    unsigned long count_, next_;
+    double sum_, max_;
+  };
+}
+#endif
@@ -6,6 +6,7 @@
 #include <generic_control_toolbox/manager_base.hpp>
 #include <generic_control_toolbox/matrix_parser.hpp>
 #include <tf/transform_listener.h>
+#include <generic_control_toolbox/robot_model_cache.hpp>
 #include <kdl_conversions/kdl_msg.h>
 #include <eigen_conversions/eigen_msg.h>
 #include <tf/transform_broadcaster.h>
@@ -64,7 +65,7 @@ namespace generic_control_toolbox
     std::vector<ros::Publisher> processed_ft_pub_;
     std::vector<std::string> gripping_frame_;
     std::vector<Eigen::Matrix<double, 6, 6> > calibration_matrix_;
-    tf::TransformListener listener_;
+    std::shared_ptr<tf::TransformListener> listener_; /// shared through RobotModelCache
     MatrixParser parser_;
     ros::NodeHandle nh_;
 
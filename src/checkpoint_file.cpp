@@ -0,0 +1,211 @@
+#include <generic_control_toolbox/checkpoint_file.hpp>
+#include <ros/ros.h>
+#include <boost/crc.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+namespace generic_control_toolbox
+{
+  /**
+    Rounds a size up to a cache line.
+  **/
+  static uint64_t alignBytes(uint64_t bytes)
+  {
+    return (bytes + 63) & ~static_cast<uint64_t>(63);
+  }
+
+  CheckpointFile::CheckpointFile() : addr_(nullptr), bytes_(0), slot_bytes_(0), capacity_(0), seq_(0) {}
+
+  CheckpointFile::~CheckpointFile()
+  {
+    close();
+  }
+
+  bool CheckpointFile::open(const std::string &file_name, const std::string &type, uint32_t capacity)
+  {
+    close();
+
+    if (capacity == 0)
+    {
+      ROS_ERROR("CheckpointFile: the capacity must be positive");
+      return false;
+    }
+
+    file_name_ = file_name;
+    capacity_ = capacity;
+    slot_bytes_ = alignBytes(sizeof(CheckpointSlot) + capacity);
+    bytes_ = alignBytes(sizeof(CheckpointHeader)) + 2*slot_bytes_;
+
+    int fd = ::open(file_name_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+      ROS_ERROR("CheckpointFile: failed to open %s: %s", file_name_.c_str(), strerror(errno));
+      return false;
+    }
+
+    struct stat st;
+    bool existed = fstat(fd, &st) == 0 && st.st_size > 0;
+    bool resize = !existed || static_cast<uint64_t>(st.st_size) != bytes_;
+    if (resize && (ftruncate(fd, 0) != 0 || ftruncate(fd, bytes_) != 0)) // zero-filled
+    {
+      ROS_ERROR("CheckpointFile: failed to resize %s: %s", file_name_.c_str(), strerror(errno));
+      ::close(fd);
+      return false;
+    }
+
+    void *addr = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+      ROS_ERROR("CheckpointFile: failed to map %s: %s", file_name_.c_str(), strerror(errno));
+      return false;
+    }
+
+    addr_ = static_cast<uint8_t*>(addr);
+
+    CheckpointHeader expected;
+    memset(&expected, 0, sizeof(expected));
+    memcpy(expected.magic, CHECKPOINT_MAGIC, sizeof(expected.magic));
+    expected.version = CHECKPOINT_VERSION;
+    expected.capacity = capacity_;
+    strncpy(expected.type, type.c_str(), CHECKPOINT_TYPE_LENGTH - 1);
+
+    if (memcmp(addr_, &expected, sizeof(expected)) != 0)
+    {
+      if (existed)
+      {
+        ROS_WARN("CheckpointFile: %s was written for a different goal type or capacity, discarding it", file_name_.c_str());
+      }
+
+      memset(addr_, 0, bytes_);
+      memcpy(addr_, &expected, sizeof(expected));
+    }
+
+    int newest = newestSlot();
+    seq_ = newest >= 0 ? slot(newest)->seq : 0;
+    return true;
+  }
+
+  void CheckpointFile::close()
+  {
+    if (addr_)
+    {
+      msync(addr_, bytes_, MS_ASYNC);
+      munmap(addr_, bytes_);
+    }
+
+    addr_ = nullptr;
+  }
+
+  bool CheckpointFile::isOpen() const
+  {
+    return addr_ != nullptr;
+  }
+
+  bool CheckpointFile::load(std::vector<uint8_t> &goal, std::vector<uint8_t> &state) const
+  {
+    if (!addr_)
+    {
+      return false;
+    }
+
+    int newest = newestSlot();
+    if (newest < 0 || slot(newest)->goal_size == 0)
+    {
+      return false;
+    }
+
+    const CheckpointSlot *s = slot(newest);
+    const uint8_t *data = slotData(newest);
+    goal.assign(data, data + s->goal_size);
+    state.assign(data + s->goal_size, data + s->goal_size + s->state_size);
+    return true;
+  }
+
+  bool CheckpointFile::save(const std::vector<uint8_t> &goal, const std::vector<uint8_t> &state)
+  {
+    if (!addr_)
+    {
+      return false;
+    }
+
+    if (goal.size() + state.size() > capacity_)
+    {
+      ROS_ERROR_THROTTLE(10, "CheckpointFile: checkpoint of %lu bytes exceeds the capacity of %s (%u bytes)", goal.size() + state.size(), file_name_.c_str(), capacity_);
+      return false;
+    }
+
+    // overwrite the older slot, so the newest one stays valid until this one is complete
+    seq_++;
+    unsigned int i = seq_ % 2;
+    CheckpointSlot *s = slot(i);
+    uint8_t *data = slotData(i);
+
+    if (!goal.empty())
+    {
+      memcpy(data, goal.data(), goal.size());
+    }
+
+    if (!state.empty())
+    {
+      memcpy(data + goal.size(), state.data(), state.size());
+    }
+
+    s->seq = seq_;
+    s->goal_size = goal.size();
+    s->state_size = state.size();
+    s->crc = checksum(i);
+    msync(addr_, bytes_, MS_ASYNC); // schedules the write-back without waiting for it
+    return true;
+  }
+
+  void CheckpointFile::clear()
+  {
+    save(std::vector<uint8_t>(), std::vector<uint8_t>());
+  }
+
+  CheckpointSlot *CheckpointFile::slot(unsigned int i) const
+  {
+    return reinterpret_cast<CheckpointSlot*>(addr_ + alignBytes(sizeof(CheckpointHeader)) + i*slot_bytes_);
+  }
+
+  uint8_t *CheckpointFile::slotData(unsigned int i) const
+  {
+    return reinterpret_cast<uint8_t*>(slot(i)) + sizeof(CheckpointSlot);
+  }
+
+  uint32_t CheckpointFile::checksum(unsigned int i) const
+  {
+    const CheckpointSlot *s = slot(i);
+    boost::crc_32_type crc;
+    crc.process_bytes(&s->seq, sizeof(s->seq));
+    crc.process_bytes(&s->goal_size, sizeof(s->goal_size));
+    crc.process_bytes(&s->state_size, sizeof(s->state_size));
+    crc.process_bytes(slotData(i), s->goal_size + s->state_size);
+    return crc.checksum();
+  }
+
+  int CheckpointFile::newestSlot() const
+  {
+    int newest = -1;
+    for (unsigned int i = 0; i < 2; i++)
+    {
+      const CheckpointSlot *s = slot(i);
+      if (s->seq == 0 || static_cast<uint64_t>(s->goal_size) + s->state_size > capacity_ || s->crc != checksum(i))
+      {
+        continue;
+      }
+
+      if (newest < 0 || s->seq > slot(newest)->seq)
+      {
+        newest = i;
+      }
+    }
+
+    return newest;
+  }
+}
@@ -0,0 +1,287 @@
+#include <generic_control_toolbox/command_filter.hpp>
+#include <generic_control_toolbox/robot_model_cache.hpp>
+#include <generic_control_toolbox/controller_template.hpp>
+#include <limits>
+
+namespace generic_control_toolbox
+{
+  CommandFilter::CommandFilter() : default_max_acceleration_(std::numeric_limits<double>::infinity()), default_max_jerk_(std::numeric_limits<double>::infinity()), default_deadband_(0.0), has_prev_position_(false), has_prev_velocity_(false), has_seed_(false) {}
+
+  CommandFilter::~CommandFilter()
+  {
+    logViolations();
+  }
+
+  void CommandFilter::init(const ros::NodeHandle &nh, const std::string &robot_description)
+  {
+    nh_ = nh;
+    default_max_acceleration_ = jointParam("", "max_acceleration", std::numeric_limits<double>::infinity());
+    default_max_jerk_ = jointParam("", "max_jerk", std::numeric_limits<double>::infinity());
+    default_deadband_ = jointParam("", "deadband", 0.0);
+
+    model_ = RobotModelCache::getModel(robot_description);
+    if (!model_)
+    {
+      ROS_WARN("CommandFilter: could not load the robot description (%s). Joint position, velocity and effort limits will not be enforced", robot_description.c_str());
+    }
+
+    names_.clear();
+    reset();
+  }
+
+  void CommandFilter::reset(const sensor_msgs::JointState &state)
+  {
+    copyJointState(state, seed_);
+    has_seed_ = state.position.size() == state.name.size() && !state.name.empty();
+    reset();
+  }
+
+  void CommandFilter::reset()
+  {
+    has_prev_position_ = false;
+    has_prev_velocity_ = false;
+  }
+
+  unsigned int CommandFilter::filter(sensor_msgs::JointState &command, double dt)
+  {
+    unsigned long n = command.name.size();
+    if (n == 0)
+    {
+      return 0;
+    }
+
+    if (command.name != names_)
+    {
+      logViolations(); // the counters restart with the new joints
+      loadLimits(command.name);
+    }
+
+    bool valid_dt = dt > 0 && dt <= MAX_DT;
+    unsigned int violations = 0;
+
+    if (has_seed_ && !has_prev_position_ && !has_prev_velocity_)
+    {
+      has_seed_ = false;
+      if (!seedLimits(command.name))
+      {
+        ROS_WARN("CommandFilter: the joint state misses some of the commanded joints, their rate limits start from the first command");
+      }
+    }
+
+    if (command.position.size() == n)
+    {
+      Eigen::Map<Eigen::ArrayXd> q(command.position.data(), n);
+
+      position_violations_ += ((q < lower_) || (q > upper_)).cast<unsigned long>();
+      violations += ((q < lower_) || (q > upper_)).count();
+      q = q.max(lower_).min(upper_);
+
+      if (has_prev_position_ && valid_dt)
+      {
+        q = ((q - q_prev_).abs() < deadband_).select(q_prev_, q);
+        v_ = (q - q_prev_)/dt;
+
+        // do not approach the target faster than the acceleration limit can stop at it
+        a_ = (2*max_acceleration_*(q - q_prev_).abs()).sqrt();
+        a_ = (q == q_prev_).select(0.0, a_);
+        v_ = v_.max(-a_).min(a_);
+
+        violations += limitRates(v_, qv_prev_, qa_prev_, dt);
+        q = (q_prev_ + v_*dt).max(lower_).min(upper_); // decelerating may overshoot the target
+      }
+      else if (has_prev_position_)
+      {
+        q = q_prev_; // the rates cannot be limited without a valid dt, hold the previous command
+      }
+      else
+      {
+        qv_prev_.setZero();
+        qa_prev_.setZero();
+        has_prev_position_ = true;
+      }
+
+      q_prev_ = q;
+    }
+
+    if (command.velocity.size() == n)
+    {
+      Eigen::Map<Eigen::ArrayXd> v(command.velocity.data(), n);
+
+      if (has_prev_velocity_ && valid_dt)
+      {
+        v_ = v;
+        violations += limitRates(v_, v_prev_, va_prev_, dt);
+        v = v_;
+      }
+      else if (has_prev_velocity_)
+      {
+        v = v_prev_;
+      }
+      else
+      {
+        velocity_violations_ += (v.abs() > max_velocity_).cast<unsigned long>();
+        violations += (v.abs() > max_velocity_).count();
+        v = v.max(-max_velocity_).min(max_velocity_);
+        v_prev_ = v;
+        va_prev_.setZero();
+        has_prev_velocity_ = true;
+      }
+    }
+
+    if (command.effort.size() == n)
+    {
+      Eigen::Map<Eigen::ArrayXd> effort(command.effort.data(), n);
+
+      effort_violations_ += (effort.abs() > max_effort_).cast<unsigned long>();
+      violations += (effort.abs() > max_effort_).count();
+      effort = effort.max(-max_effort_).min(max_effort_);
+    }
+
+    return violations;
+  }
+
+  unsigned int CommandFilter::limitRates(Eigen::ArrayXd &v, Eigen::ArrayXd &v_prev, Eigen::ArrayXd &a_prev, double dt)
+  {
+    unsigned int violations = 0;
+    a_ = (v - v_prev)/dt;
+
+    jerk_violations_ += ((a_ - a_prev).abs() > max_jerk_*dt).cast<unsigned long>();
+    violations += ((a_ - a_prev).abs() > max_jerk_*dt).count();
+    a_ = a_.max(a_prev - max_jerk_*dt).min(a_prev + max_jerk_*dt);
+
+    acceleration_violations_ += (a_.abs() > max_acceleration_).cast<unsigned long>();
+    violations += (a_.abs() > max_acceleration_).count();
+    a_ = a_.max(-max_acceleration_).min(max_acceleration_);
+
+    v = v_prev + a_*dt;
+    velocity_violations_ += (v.abs() > max_velocity_).cast<unsigned long>();
+    violations += (v.abs() > max_velocity_).count();
+    v = v.max(-max_velocity_).min(max_velocity_);
+
+    a_prev = (v - v_prev)/dt;
+    v_prev = v;
+    return violations;
+  }
+
+  bool CommandFilter::seedLimits(const std::vector<std::string> &names)
+  {
+    unsigned long n = names.size();
+    bool has_velocity = seed_.velocity.size() == seed_.name.size();
+
+    for (unsigned long i = 0; i < n; i++)
+    {
+      unsigned long j = 0;
+      while (j < seed_.name.size() && seed_.name[j] != names[i])
+      {
+        j++;
+      }
+
+      if (j == seed_.name.size())
+      {
+        return false;
+      }
+
+      q_prev_[i] = seed_.position[j];
+      qv_prev_[i] = has_velocity ? seed_.velocity[j] : 0.0;
+      v_prev_[i] = qv_prev_[i];
+    }
+
+    qa_prev_.setZero();
+    va_prev_.setZero();
+    has_prev_position_ = true;
+    has_prev_velocity_ = true;
+    return true;
+  }
+
+  void CommandFilter::logViolations() const
+  {
+    for (unsigned long i = 0; i < names_.size(); i++)
+    {
+      if (position_violations_[i] + velocity_violations_[i] + acceleration_violations_[i] + jerk_violations_[i] + effort_violations_[i] > 0)
+      {
+        ROS_WARN("CommandFilter: joint %s violated its position limits %lu times, velocity %lu, acceleration %lu, jerk %lu and effort %lu", names_[i].c_str(), position_violations_[i], velocity_violations_[i], acceleration_violations_[i], jerk_violations_[i], effort_violations_[i]);
+      }
+    }
+  }
+
+  void CommandFilter::loadLimits(const std::vector<std::string> &names)
+  {
+    unsigned long n = names.size();
+    double inf = std::numeric_limits<double>::infinity();
+
+    names_ = names;
+    lower_.setConstant(n, -inf);
+    upper_.setConstant(n, inf);
+    max_velocity_.setConstant(n, inf);
+    max_effort_.setConstant(n, inf);
+    max_acceleration_.resize(n);
+    max_jerk_.resize(n);
+    deadband_.resize(n);
+
+    for (unsigned long i = 0; i < n; i++)
+    {
+      max_acceleration_[i] = jointParam(names[i], "max_acceleration", default_max_acceleration_);
+      max_jerk_[i] = jointParam(names[i], "max_jerk", default_max_jerk_);
+      deadband_[i] = jointParam(names[i], "deadband", default_deadband_);
+
+      if (!model_)
+      {
+        continue;
+      }
+
+      urdf::JointConstSharedPtr joint = model_->getJoint(names[i]);
+      if (!joint || !joint->limits)
+      {
+        ROS_WARN_STREAM("CommandFilter: no limits for joint " << names[i]);
+        continue;
+      }
+
+      if (joint->type != urdf::Joint::CONTINUOUS && joint->limits->lower < joint->limits->upper)
+      {
+        lower_[i] = joint->limits->lower;
+        upper_[i] = joint->limits->upper;
+      }
+
+      if (joint->limits->velocity > 0)
+      {
+        max_velocity_[i] = joint->limits->velocity;
+      }
+
+      if (joint->limits->effort > 0)
+      {
+        max_effort_[i] = joint->limits->effort;
+      }
+    }
+
+    q_prev_.setZero(n);
+    qv_prev_.setZero(n);
+    qa_prev_.setZero(n);
+    v_prev_.setZero(n);
+    va_prev_.setZero(n);
+    v_.setZero(n);
+    a_.setZero(n);
+    position_violations_.setZero(n);
+    velocity_violations_.setZero(n);
+    acceleration_violations_.setZero(n);
+    jerk_violations_.setZero(n);
+    effort_violations_.setZero(n);
+    reset();
+  }
+
+  double CommandFilter::jointParam(const std::string &joint, const std::string &name, double default_value) const
+  {
+    double value;
+    if (!nh_.getParam(joint.empty() ? name : "joints/" + joint + "/" + name, value))
+    {
+      return default_value;
+    }
+
+    if (value < 0)
+    {
+      ROS_ERROR("CommandFilter: %s must not be negative. Using default.", name.c_str());
+      return default_value;
+    }
+
+    return value;
+  }
+}
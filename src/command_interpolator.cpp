@@ -0,0 +1,207 @@
+#include <generic_control_toolbox/command_interpolator.hpp>
+#include <generic_control_toolbox/realtime_utils.hpp>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace generic_control_toolbox
+{
+  CommandInterpolator::CommandInterpolator() : has_model_(false), streaming_(false), period_(0.001), segment_time_(0.0), segment_duration_(0.0), stop_(false) {}
+
+  CommandInterpolator::~CommandInterpolator()
+  {
+    stop();
+  }
+
+  bool CommandInterpolator::start(const ros::Publisher &pub, double rate, int priority, double poll_rate, int cpu, bool shared)
+  {
+    if (thread_.joinable())
+    {
+      ROS_ERROR("CommandInterpolator: tried to start an interpolator which is already running");
+      return false;
+    }
+
+    if (rate <= 0)
+    {
+      ROS_ERROR("CommandInterpolator: the command rate must be positive");
+      return false;
+    }
+
+    if (poll_rate < rate)
+    {
+      ROS_WARN("CommandInterpolator: the publisher poll rate (%.1f Hz) is lower than the command rate (%.1f Hz), commands will be dropped", poll_rate, rate);
+    }
+
+    model_ = RobotModelCache::getModel("/robot_description");
+    has_model_ = model_ != nullptr;
+    if (!has_model_)
+    {
+      ROS_WARN("CommandInterpolator: could not load the robot description (/robot_description). Joint velocity limits will not be enforced");
+    }
+
+    period_ = 1.0/rate;
+    if (!publisher_.start(pub, poll_rate, period_, cpu, shared))
+    {
+      return false;
+    }
+
+    stop_ = false;
+    thread_ = std::thread(&CommandInterpolator::interpolationThread, this);
+
+    if (priority > 0)
+    {
+      setThreadPriority(thread_, priority);
+    }
+
+    return true;
+  }
+
+  void CommandInterpolator::stop()
+  {
+    stop_ = true;
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+
+    publisher_.stop();
+  }
+
+  void CommandInterpolator::setTarget(const sensor_msgs::JointState &command, const ros::Duration &duration, bool active)
+  {
+    Target &target = targets_.writeBuffer();
+    copyJointState(command, target.command);
+    target.duration = duration.toSec();
+    target.active = active;
+    targets_.publish();
+  }
+
+  void CommandInterpolator::interpolationThread()
+  {
+    std::chrono::nanoseconds period(static_cast<long long>(1e9*period_));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    while (!stop_)
+    {
+      if (targets_.update())
+      {
+        const Target &target = targets_.readBuffer();
+
+        if (target.active)
+        {
+          startSegment(target);
+          streaming_ = true;
+        }
+        else
+        {
+          streaming_ = false;
+          bool renamed = command_.name != target.command.name;
+          copyJointState(target.command, command_); // the next segment starts from here
+          if (renamed)
+          {
+            loadLimits();
+          }
+
+          publisher_.publish(command_);
+        }
+      }
+
+      if (streaming_)
+      {
+        segment_time_ += period_;
+        evaluate(segment_time_);
+        publisher_.publish(command_);
+      }
+
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  void CommandInterpolator::startSegment(const Target &target)
+  {
+    const sensor_msgs::JointState &command = target.command;
+    unsigned int n = command.name.size();
+
+    if (command.position.size() != n)
+    {
+      ROS_ERROR_THROTTLE(10, "CommandInterpolator: got a command with %zu positions for %u joints", command.position.size(), n);
+      return;
+    }
+
+    if (command_.name != command.name || command_.position.size() != n || q0_.size() != n) // new set of joints or no position to start from, start from the command
+    {
+      bool renamed = command_.name != command.name;
+      copyJointState(command, command_);
+      q0_.resize(n);
+      v0_.resize(n);
+      q1_.resize(n);
+      v1_.resize(n);
+      if (renamed)
+      {
+        loadLimits();
+      }
+    }
+
+    // a held command may have no velocities
+    command_.position.resize(n);
+    command_.velocity.resize(n, 0.0);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+      q0_[i] = command_.position[i];
+      v0_[i] = command_.velocity[i];
+      q1_[i] = command.position[i];
+      v1_[i] = command.velocity.size() == n ? command.velocity[i] : 0.0;
+    }
+
+    command_.effort.assign(command.effort.begin(), command.effort.end());
+    command_.header.stamp = command.header.stamp; // keep the stamp of the state the command was computed from
+    segment_time_ = 0.0;
+    segment_duration_ = target.duration > 0 ? target.duration : period_;
+  }
+
+  void CommandInterpolator::evaluate(double t)
+  {
+    double T = segment_duration_;
+    double s = std::min(t/T, 1.0);
+    double s2 = s*s, s3 = s2*s;
+
+    // cubic Hermite basis functions and their time derivatives
+    double h00 = 2*s3 - 3*s2 + 1, h10 = s3 - 2*s2 + s, h01 = -2*s3 + 3*s2, h11 = s3 - s2;
+    double dh00 = (6*s2 - 6*s)/T, dh10 = 3*s2 - 4*s + 1, dh01 = (-6*s2 + 6*s)/T, dh11 = 3*s2 - 2*s;
+
+    for (unsigned long i = 0; i < q0_.size(); i++)
+    {
+      double q = h00*q0_[i] + h10*T*v0_[i] + h01*q1_[i] + h11*T*v1_[i];
+      double v = dh00*q0_[i] + dh10*v0_[i] + dh01*q1_[i] + dh11*v1_[i];
+      double max_step = velocity_limits_[i]*period_;
+
+      command_.position[i] += std::max(-max_step, std::min(max_step, q - command_.position[i]));
+      command_.velocity[i] = std::max(-velocity_limits_[i], std::min(velocity_limits_[i], v));
+    }
+  }
+
+  void CommandInterpolator::loadLimits()
+  {
+    velocity_limits_.assign(command_.name.size(), std::numeric_limits<double>::infinity());
+
+    if (!has_model_)
+    {
+      return;
+    }
+
+    boost::shared_ptr<const urdf::Joint> joint;
+    for (unsigned long i = 0; i < command_.name.size(); i++)
+    {
+      joint = model_->getJoint(command_.name[i]);
+      if (!joint || !joint->limits || joint->limits->velocity <= 0)
+      {
+        ROS_WARN_STREAM("CommandInterpolator: no velocity limit for joint " << command_.name[i]);
+        continue;
+      }
+
+      velocity_limits_[i] = joint->limits->velocity;
+    }
+  }
+}
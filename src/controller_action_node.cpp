@@ -2,9 +2,72 @@
 
 namespace generic_control_toolbox
 {
-  ControllerActionNode::ControllerActionNode()
+  ControllerActionNode::ControllerActionNode() : ControllerActionNode(ros::NodeHandle("~"))
   {
-    nh_ = ros::NodeHandle("~");
+    spin_global_queue_ = true;
+  }
+
+  ControllerActionNode::ControllerActionNode(const ros::NodeHandle &nh, bool zero_copy) : nh_(nh), spin_global_queue_(false), next_controller_(nullptr), switch_stage_(SWITCH_NONE), stop_(false), zero_copy_(zero_copy)
+  {
+    if (!nh_.getParam("joint_state_topic", joint_state_topic_))
+    {
+      joint_state_topic_ = "/joint_states";
+    }
+
+    if (!nh_.getParam("command_topic", command_topic_))
+    {
+      command_topic_ = "/joint_command";
+    }
+
+    if (!nh_.getParam("shm_transport", shm_transport_))
+    {
+      shm_transport_ = false;
+    }
+
+    std::vector<std::string> joint_group;
+    if (nh_.getParam("joint_group", joint_group) && !joint_group.empty())
+    {
+      state_projection_.setJoints(joint_group);
+      command_projection_.setJoints(joint_group);
+      ROS_INFO("Controlling a group of %lu joints", joint_group.size());
+    }
+
+    if (!nh_.getParam("state_estimator/enabled", estimate_state_))
+    {
+      estimate_state_ = false;
+    }
+
+    if (!nh_.getParam("state_predictor/enabled", predict_state_))
+    {
+      predict_state_ = false;
+    }
+
+    if (predict_state_)
+    {
+      double actuation_delay;
+      if (!nh_.getParam("state_predictor/actuation_delay", actuation_delay))
+      {
+        ROS_WARN_STREAM("Missing state_predictor/actuation_delay parameter for " << ros::this_node::getName() << ". Using default.");
+        actuation_delay = 0.0;
+      }
+
+      predictor_.setActuationDelay(actuation_delay);
+      nh_.param("state_predictor/log_period", prediction_log_period_, 10.0);
+      estimate_state_ = true; // the predictor uses the estimated velocities and accelerations
+    }
+
+    if (estimate_state_)
+    {
+      double alpha, beta, gamma;
+      nh_.param("state_estimator/alpha", alpha, 0.5);
+      nh_.param("state_estimator/beta", beta, 0.1);
+      nh_.param("state_estimator/gamma", gamma, 0.01);
+
+      if (!estimator_.setGains(alpha, beta, gamma))
+      {
+        ROS_WARN("Using the default state estimator gains");
+      }
+    }
 
     if (!nh_.getParam("loop_rate", loop_rate_))
     {
@@ -12,39 +75,332 @@ namespace generic_control_toolbox
       loop_rate_ = 100;
     }
 
+    if (!nh_.getParam("max_state_age", max_state_age_))
+    {
+      ROS_WARN_STREAM("Missing max_state_age parameter for " << ros::this_node::getName() << ". Using default.");
+      max_state_age_ = MAX_DT;
+    }
+
+    std::string stale_state_policy;
+    if (!nh_.getParam("stale_state_policy", stale_state_policy))
+    {
+      ROS_WARN_STREAM("Missing stale_state_policy parameter for " << ros::this_node::getName() << ". Using default.");
+      stale_state_policy = "hold";
+    }
+
+    if (stale_state_policy != "hold" && stale_state_policy != "abort")
+    {
+      ROS_ERROR_STREAM("stale_state_policy has value " << stale_state_policy << " but admissible values are hold and abort. Using hold.");
+      stale_state_policy = "hold";
+    }
+
+    double command_rate;
+    int command_thread_priority;
+    if (!nh_.getParam("command_rate", command_rate))
+    {
+      command_rate = 0; // no interpolation
+    }
+
+    if (!nh_.getParam("command_thread_priority", command_thread_priority))
+    {
+      command_thread_priority = 0;
+    }
+
+    if (!nh_.getParam("flight_recorder/file", record_file_))
+    {
+      record_file_ = ""; // no recording
+    }
+
+    if (!nh_.getParam("flight_recorder/capacity", record_capacity_))
+    {
+      record_capacity_ = 4096;
+    }
+
+    if (!nh_.getParam("flight_recorder/block_size", record_block_size_))
+    {
+      record_block_size_ = 1000;
+    }
+
+    if (!nh_.getParam("command_filter/enabled", filter_commands_))
+    {
+      filter_commands_ = false;
+    }
+
+    if (filter_commands_)
+    {
+      filter_.init(ros::NodeHandle(nh_, "command_filter"));
+    }
+
+    double publisher_poll_rate;
+    int publisher_cpu;
+    if (!nh_.getParam("command_publisher/poll_rate", publisher_poll_rate))
+    {
+      publisher_poll_rate = 2000;
+    }
+
+    if (!nh_.getParam("command_publisher/cpu", publisher_cpu))
+    {
+      publisher_cpu = -1; // not pinned
+    }
+
+    double latency_statistics_period;
+    if (!nh_.getParam("latency_statistics_period", latency_statistics_period))
+    {
+      latency_statistics_period = 0; // no statistics
+    }
+
+    abort_on_stale_ = stale_state_policy == "abort";
     got_first_ = false;
-    joint_state_sub_ = nh_.subscribe("/joint_states", 1, &ControllerActionNode::jointStatesCb, this);
-    state_pub_ = nh_.advertise<sensor_msgs::JointState>("/joint_command", 1);
+    new_state_ = false;
+
+    if (shm_transport_)
+    {
+      if (command_rate > 0)
+      {
+        ROS_WARN("Commands are not interpolated with the shared memory transport");
+        command_rate = 0;
+      }
+
+      readSharedState(); // the topics are opened lazily, the driver may not be up yet
+    }
+    else
+    {
+      ros::NodeHandle state_nh(nh_);
+      state_nh.setCallbackQueue(&state_queue_);
+      joint_state_sub_ = state_nh.subscribe(joint_state_topic_, 1, &ControllerActionNode::jointStatesCb, this);
+      state_pub_ = nh_.advertise<sensor_msgs::JointState>(command_topic_, 1);
+    }
+
+    if (latency_statistics_period > 0)
+    {
+      latency_pub_ = nh_.advertise<generic_control_toolbox::LatencyStatistics>("latency_statistics", 1);
+      tracer_.start(latency_pub_, latency_statistics_period);
+    }
+
+    interpolate_ = false;
+    if (command_rate > loop_rate_)
+    {
+      interpolate_ = interpolator_.start(state_pub_, command_rate, command_thread_priority, publisher_poll_rate, publisher_cpu, zero_copy_);
+    }
+    else if (command_rate > 0)
+    {
+      ROS_WARN("command_rate is not larger than loop_rate, commands will not be interpolated");
+    }
+
+    if (!interpolate_ && !shm_transport_)
+    {
+      command_publisher_.setTracer(tracer_.isRunning() ? &tracer_ : nullptr);
+      command_publisher_.start(state_pub_, publisher_poll_rate, 1.0/loop_rate_, publisher_cpu, zero_copy_);
+    }
+  }
+
+  ControllerActionNode::~ControllerActionNode()
+  {
+    if (switch_thread_.joinable())
+    {
+      switch_thread_.join();
+    }
+  }
+
+  bool ControllerActionNode::switchController(ControllerBase &next)
+  {
+    int none = SWITCH_NONE;
+    if (!switch_stage_.compare_exchange_strong(none, SWITCH_PREPARING))
+    {
+      ROS_ERROR("A controller switch is already in progress");
+      return false;
+    }
+
+    if (switch_thread_.joinable()) // finished with the previous switch
+    {
+      switch_thread_.join();
+    }
+
+    switch_request_time_ = std::chrono::steady_clock::now();
+    next_controller_ = &next;
+    switch_thread_ = std::thread(&ControllerActionNode::prepareSwitch, this);
+    return true;
+  }
+
+  void ControllerActionNode::stop()
+  {
+    stop_ = true;
   }
 
-  ControllerActionNode::~ControllerActionNode() {}
+  void ControllerActionNode::prepareSwitch()
+  {
+    if (!next_controller_->prepareSwitch())
+    {
+      ROS_ERROR("Failed to prepare the incoming controller, not switching");
+      switch_stage_.store(SWITCH_NONE, std::memory_order_release);
+      return;
+    }
+
+    switch_ready_time_ = std::chrono::steady_clock::now();
+    switch_stage_.store(SWITCH_READY, std::memory_order_release);
+  }
 
-  void ControllerActionNode::runController(ControllerBase &controller)
+  void ControllerActionNode::completeSwitch(ControllerBase *&controller, const sensor_msgs::JointState &command)
   {
+    next_controller_->seedCommand(command);
+
+    if (controller->isActive())
+    {
+      controller->abortControl();
+    }
+
+    controller = next_controller_;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    switch_stage_.store(SWITCH_NONE, std::memory_order_release);
+
+    ROS_INFO("Switched controllers %.3f ms after the request (preparation took %.3f ms)", std::chrono::duration<double, std::milli>(now - switch_request_time_).count(), std::chrono::duration<double, std::milli>(switch_ready_time_ - switch_request_time_).count());
+  }
+
+  void ControllerActionNode::runController(ControllerBase &initial_controller)
+  {
+    ControllerBase *controller = &initial_controller;
     ros::Rate r(loop_rate_);
-    ros::Time prev_time = ros::Time::now();
-    sensor_msgs::JointState command;
-    bool was_running = false;
+    ros::Time last_stamp; // measurement time of the last state given to the controller
+    ros::Time advance_time; // reception time of the last state newer than the previous one
+    sensor_msgs::JointState command; // keeps its memory across cycles
+    LatencyTrace trace;
+    bool was_running = false, stale = false;
 
-    while(ros::ok())
+    while(ros::ok() && !stop_)
     {
-      if (got_first_) // TODO: Maybe keep track of how long was it since the last joint states msg received?
+      if (got_first_)
       {
-        command = controller.updateControl(state_, ros::Time::now() - prev_time);
-        if (controller.isActive())
+        if (new_state_ && state_stamp_ > last_stamp)
         {
-          ROS_DEBUG_THROTTLE(10, "Controller is active, publishing");
-          was_running = true;
-          state_pub_.publish(command);
+          advance_time = state_receive_time_;
         }
-        else
+
+        // a driver which republishes a frozen stamp is as stale as one which stops publishing
+        if ((ros::Time::now() - advance_time).toSec() > max_state_age_)
         {
+          if (!stale)
+          {
+            if ((ros::Time::now() - state_receive_time_).toSec() > max_state_age_)
+            {
+              ROS_ERROR_STREAM("No joint state received for more than " << max_state_age_ << " seconds");
+            }
+            else
+            {
+              ROS_ERROR_STREAM("The joint state stamps have not advanced for more than " << max_state_age_ << " seconds");
+            }
+
+            stale = true;
+
+            if (abort_on_stale_ && controller->isActive())
+            {
+              controller->abortControl();
+            }
+          }
+
           if (was_running)
           {
-            state_pub_.publish(command); // publish the last command msg
-            was_running = false;
+            holdPosition(command);
+            publishCommand(command, true);
           }
-          ROS_DEBUG_THROTTLE(10, "Controller is not active, skipping");
+        }
+        else if (new_state_)
+        {
+          if (stale)
+          {
+            ROS_WARN("Joint states are being received again");
+            stale = false;
+          }
+
+          ros::Duration dt = last_stamp.isZero() ? ros::Duration(1.0/loop_rate_) : state_stamp_ - last_stamp;
+          new_state_ = false;
+
+          if (dt.toSec() <= 0.0)
+          {
+            ROS_WARN_THROTTLE(10, "Got a joint state which is not newer than the previous one, skipping");
+
+            if (was_running)
+            {
+              holdPosition(command);
+              publishCommand(command, true);
+            }
+          }
+          else
+          {
+            last_stamp = state_stamp_;
+            trace.stamp = state_stamp_;
+            trace.receive = state_receive_time_;
+            trace.cycle_start = ros::Time::now();
+
+            if (switch_stage_.load(std::memory_order_acquire) == SWITCH_READY)
+            {
+              completeSwitch(controller, command);
+            }
+
+            bool predicted = predict_state_ && predictor_.predict(currentState(), state_stamp_, estimator_.velocity(), estimator_.acceleration(), trace.cycle_start, predicted_state_);
+            const sensor_msgs::JointState &state = predicted ? predicted_state_ : currentState();
+            controller->updateControl(state, dt, command);
+            trace.update_end = ros::Time::now();
+            command.header.stamp = state_stamp_;
+
+            if (recorder_.isRunning())
+            {
+              recorder_.record(state, dt, command, controller->isActive(), controller->goalSequence());
+            }
+            else if (!record_file_.empty() && record_capacity_ > 0 && record_block_size_ > 0)
+            {
+              if (!recorder_.start(record_file_, state.name, record_capacity_, record_block_size_))
+              {
+                record_file_ = "";
+              }
+            }
+
+            if (filter_commands_ && (controller->isActive() || was_running))
+            {
+              if (!was_running) // the rate limits start from the measured state
+              {
+                filter_.reset(state);
+              }
+
+              if (filter_.filter(command, dt.toSec()) > 0)
+              {
+                ROS_WARN_THROTTLE(10, "The controller commands violate the joint limits, limiting them");
+              }
+            }
+
+            if (controller->isActive())
+            {
+              ROS_DEBUG_THROTTLE(10, "Controller is active, publishing");
+              was_running = true;
+              publishCommand(command, true, &trace);
+            }
+            else
+            {
+              if (was_running)
+              {
+                publishCommand(command, false, &trace); // publish the last command msg
+                was_running = false;
+              }
+              else
+              {
+                trace.publish = ros::Time(); // nothing published
+              }
+              ROS_DEBUG_THROTTLE(10, "Controller is not active, skipping");
+            }
+
+            if (tracer_.isRunning() && !trace.publish.isZero())
+            {
+              tracer_.trace(trace);
+            }
+
+            if (predict_state_)
+            {
+              logPredictionError(trace.cycle_start);
+            }
+          }
+        }
+        else if (was_running && !interpolate_)
+        {
+          publishCommand(command, true); // no new measurement, keep the last command alive
         }
       }
       else
@@ -52,16 +408,183 @@ namespace generic_control_toolbox
         ROS_WARN_THROTTLE(10, "No joint state received");
       }
 
-      prev_time = ros::Time::now();
-      ros::spinOnce();
+      if (shm_transport_)
+      {
+        readSharedState();
+      }
+      else
+      {
+        state_queue_.callAvailable();
+      }
+
+      if (spin_global_queue_)
+      {
+        ros::spinOnce();
+      }
+
       r.sleep();
     }
   }
 
+  void ControllerActionNode::publishCommand(const sensor_msgs::JointState &full_command, bool active, LatencyTrace *trace)
+  {
+    if (trace)
+    {
+      trace->publish = ros::Time(); // set once the command is sent
+    }
+
+    if (command_projection_.isSet())
+    {
+      command_projection_.project(full_command, group_command_);
+    }
+
+    const sensor_msgs::JointState &command = command_projection_.isSet() ? group_command_ : full_command;
+
+    if (interpolate_)
+    {
+      interpolator_.setTarget(command, ros::Duration(1.0/loop_rate_), active);
+    }
+    else if (shm_transport_)
+    {
+      if (!shm_writer_.isOpen() || shm_writer_.jointNames() != command.name) // reordered or different joints
+      {
+        if (!shm_writer_.open(command_topic_, command.name)) // fixes the layout, only allocates here
+        {
+          ROS_ERROR_THROTTLE(10, "Failed to open the shared memory command topic %s", command_topic_.c_str());
+          return;
+        }
+      }
+
+      shm_writer_.write(command);
+    }
+    else if (trace && tracer_.isRunning())
+    {
+      command_publisher_.publish(command, *trace); // traced by the publishing thread once published
+      return;
+    }
+    else
+    {
+      command_publisher_.publish(command);
+    }
+
+    if (trace)
+    {
+      trace->publish = ros::Time::now();
+    }
+  }
+
+  void ControllerActionNode::holdPosition(sensor_msgs::JointState &command) const
+  {
+    for (unsigned long i = 0; i < command.velocity.size(); i++)
+    {
+      command.velocity[i] = 0.0;
+    }
+  }
+
   void ControllerActionNode::jointStatesCb(const sensor_msgs::JointState::ConstPtr &msg)
+  {
+    if (state_projection_.isSet())
+    {
+      if (!projectState(*msg))
+      {
+        return;
+      }
+    }
+    else if (zero_copy_ && !estimate_state_) // the estimator modifies the state
+    {
+      state_msg_ = msg; // released when the next message arrives
+    }
+    else
+    {
+      copyJointState(*msg, state_);
+    }
+
+    newState(msg->header.stamp);
+  }
+
+  const sensor_msgs::JointState &ControllerActionNode::currentState() const
+  {
+    return state_msg_ ? *state_msg_ : state_;
+  }
+
+  void ControllerActionNode::logPredictionError(const ros::Time &now)
+  {
+    if (prediction_log_time_.isZero())
+    {
+      prediction_log_time_ = now;
+      return;
+    }
+
+    if ((now - prediction_log_time_).toSec() < prediction_log_period_ || predictor_.errorCount() == 0)
+    {
+      return;
+    }
+
+    ROS_INFO("Joint state prediction %.1f ms ahead: RMS error %.3g, max error %.3g over %lu joint samples", 1000*(predictor_.actuationDelay() + (now - state_stamp_).toSec()), predictor_.rmsError(), predictor_.maxError(), predictor_.errorCount());
+    predictor_.resetError();
+    prediction_log_time_ = now;
+  }
+
+  void ControllerActionNode::readSharedState()
+  {
+    if (shm_reader_.writerClosed())
+    {
+      ROS_WARN("The shared memory joint state topic %s was closed", joint_state_topic_.c_str());
+      shm_reader_.close();
+    }
+
+    if (!shm_reader_.isOpen())
+    {
+      if (!shm_reader_.open(joint_state_topic_))
+      {
+        ROS_WARN_THROTTLE(10, "Waiting for the shared memory joint state topic %s", joint_state_topic_.c_str());
+        return;
+      }
+
+      ROS_INFO("Opened the shared memory joint state topic %s with %lu joints", joint_state_topic_.c_str(), shm_reader_.jointNames().size());
+    }
+
+    if (state_projection_.isSet())
+    {
+      if (shm_reader_.read(shm_state_) && projectState(shm_state_))
+      {
+        newState(state_.header.stamp);
+      }
+    }
+    else if (shm_reader_.read(state_))
+    {
+      newState(state_.header.stamp);
+    }
+  }
+
+  bool ControllerActionNode::projectState(const sensor_msgs::JointState &msg)
+  {
+    if (!state_projection_.project(msg, state_))
+    {
+      ROS_ERROR_THROTTLE(10, "The joint states do not include all the joints of joint_group, ignoring them");
+      return false;
+    }
+
+    return true;
+  }
+
+  void ControllerActionNode::newState(const ros::Time &stamp)
   {
     ROS_INFO_ONCE("Joint state received!");
-    state_ = *msg;
+    state_receive_time_ = ros::Time::now();
+    state_stamp_ = stamp.isZero() ? state_receive_time_ : stamp; // drivers that do not stamp their messages
+
+    if (estimate_state_ && !estimator_.update(state_, state_stamp_))
+    {
+      ROS_ERROR_THROTTLE(10, "The joint states have no positions, velocities are not estimated");
+    }
+
+    if (predict_state_)
+    {
+      predictor_.observe(state_, state_stamp_);
+    }
+
+    new_state_ = true;
     got_first_ = true;
   }
 }
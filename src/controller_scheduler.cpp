@@ -0,0 +1,324 @@
+#include <generic_control_toolbox/controller_scheduler.hpp>
+#include <algorithm>
+
+namespace generic_control_toolbox
+{
+  ControllerScheduler::ControllerScheduler() : running_(false), stop_threads_(false)
+  {
+    nh_ = ros::NodeHandle("~");
+
+    if (!nh_.getParam("workers", num_workers_))
+    {
+      ROS_WARN_STREAM("Missing workers parameter for " << ros::this_node::getName() << ". Using default.");
+      num_workers_ = 1;
+    }
+
+    if (num_workers_ < 1)
+    {
+      ROS_ERROR("workers must be positive. Using default.");
+      num_workers_ = 1;
+    }
+
+    if (!nh_.getParam("worker_cpus", worker_cpus_))
+    {
+      worker_cpus_.clear(); // not pinned
+    }
+
+    if (!nh_.getParam("publish_rate", publish_rate_))
+    {
+      ROS_WARN_STREAM("Missing publish_rate parameter for " << ros::this_node::getName() << ". Using default.");
+      publish_rate_ = 100;
+    }
+  }
+
+  ControllerScheduler::~ControllerScheduler()
+  {
+    stop_threads_ = true;
+    for (unsigned long i = 0; i < workers_.size(); i++)
+    {
+      if (workers_[i]->thread.joinable())
+      {
+        workers_[i]->thread.join();
+      }
+    }
+  }
+
+  bool ControllerScheduler::addController(BasePtr controller, double rate, int priority, const std::string &joint_group)
+  {
+    if (running_)
+    {
+      ROS_ERROR("Controllers cannot be added to a running scheduler");
+      return false;
+    }
+
+    if (!controller || rate <= 0)
+    {
+      ROS_ERROR("Tried to add an invalid controller to the scheduler");
+      return false;
+    }
+
+    std::shared_ptr<ScheduledController> scheduled(new ScheduledController());
+    scheduled->controller = controller;
+    scheduled->period = std::chrono::nanoseconds(static_cast<long long>(1e9/rate));
+    scheduled->priority = priority;
+    scheduled->was_running = false;
+
+    ControllerOutput output;
+    output.active = false;
+    scheduled->output.initialize(output);
+
+    unsigned int g;
+    for (g = 0; g < groups_.size(); g++)
+    {
+      if (groups_[g].name == joint_group)
+      {
+        break;
+      }
+    }
+
+    if (g == groups_.size())
+    {
+      groups_.push_back(JointGroup());
+      groups_[g].name = joint_group;
+      groups_[g].pub = nh_.advertise<sensor_msgs::JointState>(joint_group.empty() ? "/joint_command" : "/" + joint_group + "/joint_command", 1);
+    }
+
+    scheduled->group = g;
+    groups_[g].controllers.push_back(controllers_.size());
+    controllers_.push_back(scheduled);
+    return true;
+  }
+
+  void ControllerScheduler::run()
+  {
+    if (controllers_.empty())
+    {
+      ROS_ERROR("No controllers to schedule");
+      return;
+    }
+
+    // distribute the controllers by decreasing priority
+    std::vector<unsigned int> order(controllers_.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+      order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return controllers_[a]->priority > controllers_[b]->priority; });
+
+    unsigned int num_workers = std::min<unsigned int>(num_workers_, controllers_.size());
+    for (unsigned int w = 0; w < num_workers; w++)
+    {
+      workers_.push_back(std::shared_ptr<Worker>(new Worker()));
+      workers_[w]->priority = 0;
+    }
+
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+      Worker &worker = *workers_[i % num_workers];
+      worker.controllers.push_back(order[i]);
+      worker.priority = std::max(worker.priority, controllers_[order[i]]->priority);
+    }
+
+    running_ = true;
+    joint_state_sub_ = nh_.subscribe("/joint_states", 1, &ControllerScheduler::jointStatesCb, this);
+
+    for (unsigned int w = 0; w < num_workers; w++)
+    {
+      workers_[w]->thread = std::thread(&ControllerScheduler::workerThread, this, w);
+
+      if (workers_[w]->priority > 0)
+      {
+        setThreadPriority(workers_[w]->thread, workers_[w]->priority);
+      }
+
+      if (w < worker_cpus_.size())
+      {
+        setThreadAffinity(workers_[w]->thread, worker_cpus_[w]);
+      }
+    }
+
+    ROS_INFO("Scheduling %lu controllers in %u workers", controllers_.size(), num_workers);
+
+    ros::Rate r(publish_rate_);
+    while (ros::ok())
+    {
+      ros::spinOnce();
+
+      for (unsigned long g = 0; g < groups_.size(); g++)
+      {
+        if (mergeGroup(groups_[g]))
+        {
+          groups_[g].pub.publish(groups_[g].command);
+        }
+      }
+
+      r.sleep();
+    }
+  }
+
+  void ControllerScheduler::workerThread(unsigned int w)
+  {
+    Worker &worker = *workers_[w];
+    std::vector<std::chrono::steady_clock::time_point> next(worker.controllers.size(), std::chrono::steady_clock::now());
+    bool got_first = false;
+
+    while (!stop_threads_)
+    {
+      if (worker.state.update())
+      {
+        got_first = true;
+      }
+
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now(), wake = now + std::chrono::milliseconds(10);
+      for (unsigned long i = 0; i < worker.controllers.size(); i++)
+      {
+        ScheduledController &c = *controllers_[worker.controllers[i]];
+
+        if (next[i] <= now)
+        {
+          const sensor_msgs::JointState &state = worker.state.readBuffer();
+
+          if (got_first && state.header.stamp > c.last_stamp)
+          {
+            ros::Duration dt = c.last_stamp.isZero() ? ros::Duration(std::chrono::duration<double>(c.period).count()) : state.header.stamp - c.last_stamp;
+            c.last_stamp = state.header.stamp;
+
+            ControllerOutput &output = c.output.writeBuffer();
+            c.controller->updateControl(state, dt, output.command);
+            output.active = c.controller->isActive();
+            output.stamp = state.header.stamp;
+            c.output.publish();
+          }
+
+          next[i] += c.period;
+          if (next[i] < now) // overrun, do not try to catch up
+          {
+            next[i] = now + c.period;
+          }
+        }
+
+        wake = std::min(wake, next[i]);
+      }
+
+      std::this_thread::sleep_until(wake);
+    }
+  }
+
+  bool ControllerScheduler::mergeGroup(JointGroup &group)
+  {
+    bool publish = false;
+
+    // rebuilt from the running controllers, so the joints of stopped controllers are not held forever
+    group.index.clear();
+    group.fields.clear();
+    group.command.name.clear();
+    group.command.position.clear();
+    group.command.velocity.clear();
+    group.command.effort.clear();
+    group.command.header.stamp = ros::Time();
+
+    for (unsigned long i = 0; i < group.controllers.size(); i++)
+    {
+      ScheduledController &c = *controllers_[group.controllers[i]];
+
+      bool updated = c.output.update();
+      const ControllerOutput &output = c.output.readBuffer();
+      bool stopped = updated && !output.active && c.was_running; // publish the last command after the controller stops
+      if (updated)
+      {
+        c.was_running = output.active;
+      }
+
+      if (!output.active && !stopped)
+      {
+        continue;
+      }
+
+      publish = publish || updated;
+      if (output.stamp > group.command.header.stamp)
+      {
+        group.command.header.stamp = output.stamp;
+      }
+
+      const sensor_msgs::JointState &command = output.command;
+
+      for (unsigned long j = 0; j < command.name.size(); j++)
+      {
+        std::map<std::string, unsigned int>::iterator it = group.index.find(command.name[j]);
+        if (it == group.index.end())
+        {
+          it = group.index.insert(std::make_pair(command.name[j], group.command.name.size())).first;
+          group.command.name.push_back(command.name[j]);
+          group.command.position.push_back(0.0);
+          group.command.velocity.push_back(0.0);
+          group.command.effort.push_back(0.0);
+          group.fields.push_back(0);
+        }
+
+        if (command.position.size() == command.name.size())
+        {
+          group.command.position[it->second] = command.position[j];
+          group.fields[it->second] |= POSITION_FIELD;
+        }
+
+        if (command.velocity.size() == command.name.size())
+        {
+          group.command.velocity[it->second] = command.velocity[j];
+          group.fields[it->second] |= VELOCITY_FIELD;
+        }
+
+        if (command.effort.size() == command.name.size())
+        {
+          group.command.effort[it->second] = command.effort[j];
+          group.fields[it->second] |= EFFORT_FIELD;
+        }
+      }
+    }
+
+    unsigned int all = group.fields.empty() ? 0 : POSITION_FIELD | VELOCITY_FIELD | EFFORT_FIELD, any = 0;
+    for (unsigned long j = 0; j < group.fields.size(); j++)
+    {
+      all &= group.fields[j];
+      any |= group.fields[j];
+    }
+
+    if (all != any)
+    {
+      ROS_ERROR_THROTTLE(10, "ControllerScheduler: the controllers of joint group %s command different fields, e.g., positions for some joints and velocities for others. Not publishing the group command", group.name.c_str());
+      return false;
+    }
+
+    // fields which no joint has are not published
+    if (!(all & POSITION_FIELD))
+    {
+      group.command.position.clear();
+    }
+
+    if (!(all & VELOCITY_FIELD))
+    {
+      group.command.velocity.clear();
+    }
+
+    if (!(all & EFFORT_FIELD))
+    {
+      group.command.effort.clear();
+    }
+
+    return publish;
+  }
+
+  void ControllerScheduler::jointStatesCb(const sensor_msgs::JointState::ConstPtr &msg)
+  {
+    ROS_INFO_ONCE("Joint state received!");
+    ros::Time stamp = msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp; // drivers that do not stamp their messages
+
+    for (unsigned long w = 0; w < workers_.size(); w++)
+    {
+      sensor_msgs::JointState &state = workers_[w]->state.writeBuffer();
+      copyJointState(*msg, state);
+      state.header.stamp = stamp;
+      workers_[w]->state.publish();
+    }
+  }
+}
@@ -2,8 +2,87 @@
 
 namespace generic_control_toolbox
 {
+  ServerCallbackQueue::ServerCallbackQueue() : pending_(false) {}
+
+  void ServerCallbackQueue::addCallback(const ros::CallbackInterfacePtr &callback, uint64_t owner_id)
+  {
+    queue_.addCallback(callback, owner_id);
+    wake();
+  }
+
+  void ServerCallbackQueue::removeByID(uint64_t owner_id)
+  {
+    queue_.removeByID(owner_id);
+  }
+
+  void ServerCallbackQueue::waitAndCall(const std::chrono::steady_clock::time_point &deadline)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_until(lock, deadline, [this]{ return pending_.load(); });
+      pending_ = false;
+    }
+
+    queue_.callAvailable();
+  }
+
+  void ServerCallbackQueue::wake()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_ = true;
+    }
+
+    cv_.notify_one();
+  }
+
+  void ServerCallbackQueue::notify()
+  {
+    pending_ = true;
+    cv_.notify_one();
+  }
+
   ControllerBase::ControllerBase() {}
   ControllerBase::~ControllerBase() {}
 
+  void ControllerBase::updateControl(const sensor_msgs::JointState &current_state, const ros::Duration &dt, sensor_msgs::JointState &command)
+  {
+    command = updateControl(current_state, dt);
+  }
+
+  void ControllerBase::abortControl()
+  {
+    resetInternalState();
+  }
+
+  bool ControllerBase::prepareSwitch()
+  {
+    resetInternalState();
+    return true;
+  }
+
+  void ControllerBase::seedCommand(const sensor_msgs::JointState &command) {}
+
+  unsigned int ControllerBase::goalSequence() const
+  {
+    return 0;
+  }
+
+  void copyJointState(const sensor_msgs::JointState &in, sensor_msgs::JointState &out)
+  {
+    out.header.seq = in.header.seq;
+    out.header.stamp = in.header.stamp;
+    out.header.frame_id.assign(in.header.frame_id);
+
+    if (out.name != in.name)
+    {
+      out.name = in.name;
+    }
+
+    out.position.assign(in.position.begin(), in.position.end());
+    out.velocity.assign(in.velocity.begin(), in.velocity.end());
+    out.effort.assign(in.effort.begin(), in.effort.end());
+  }
+
   // Implementation of the template class in the header file to prevent linking errors
 }
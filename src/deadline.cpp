@@ -0,0 +1,37 @@
+#include <generic_control_toolbox/deadline.hpp>
+#include <limits>
+
+namespace generic_control_toolbox
+{
+  Deadline::Deadline() : set_(false) {}
+  Deadline::~Deadline() {}
+
+  void Deadline::start(double budget)
+  {
+    set_ = budget > 0;
+    if (set_)
+    {
+      end_ = std::chrono::steady_clock::now() + std::chrono::nanoseconds(static_cast<long long>(budget*1e9));
+    }
+  }
+
+  double Deadline::remaining() const
+  {
+    if (!set_)
+    {
+      return std::numeric_limits<double>::infinity();
+    }
+
+    return std::chrono::duration<double>(end_ - std::chrono::steady_clock::now()).count();
+  }
+
+  bool Deadline::expired() const
+  {
+    return set_ && std::chrono::steady_clock::now() > end_;
+  }
+
+  bool Deadline::isSet() const
+  {
+    return set_;
+  }
+}
@@ -0,0 +1,204 @@
+#include <generic_control_toolbox/flight_record_reader.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace generic_control_toolbox
+{
+  FlightRecordReader::FlightRecordReader() : data_(NULL), file_bytes_(0), header_bytes_(0), block_bytes_(0), size_(0), num_joints_(0), block_size_(0) {}
+
+  FlightRecordReader::~FlightRecordReader()
+  {
+    close();
+  }
+
+  bool FlightRecordReader::open(const std::string &file_name)
+  {
+    close();
+
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      ROS_ERROR("FlightRecordReader: failed to open %s", file_name.c_str());
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FlightRecordHeader)))
+    {
+      ROS_ERROR("FlightRecordReader: %s is not a flight record", file_name.c_str());
+      ::close(fd);
+      return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+      ROS_ERROR("FlightRecordReader: failed to map %s", file_name.c_str());
+      return false;
+    }
+
+    data_ = static_cast<const char*>(data);
+    file_bytes_ = st.st_size;
+
+    FlightRecordHeader header;
+    memcpy(&header, data_, sizeof(header));
+    if (memcmp(header.magic, FLIGHT_RECORD_MAGIC, sizeof(header.magic)) != 0 || header.version != FLIGHT_RECORD_VERSION || header.block_size == 0)
+    {
+      ROS_ERROR("FlightRecordReader: %s is not a flight record of version %u", file_name.c_str(), FLIGHT_RECORD_VERSION);
+      close();
+      return false;
+    }
+
+    num_joints_ = header.num_joints;
+    block_size_ = header.block_size;
+    header_bytes_ = sizeof(header) + static_cast<uint64_t>(num_joints_)*header.name_length;
+    block_bytes_ = flightRecordBlockBytes(num_joints_, block_size_);
+
+    if (file_bytes_ < header_bytes_)
+    {
+      ROS_ERROR("FlightRecordReader: %s is truncated", file_name.c_str());
+      close();
+      return false;
+    }
+
+    for (uint32_t i = 0; i < num_joints_; i++)
+    {
+      const char *name = data_ + sizeof(header) + i*header.name_length;
+      joint_names_.push_back(std::string(name, strnlen(name, header.name_length)));
+    }
+
+    uint64_t blocks = (file_bytes_ - header_bytes_)/block_bytes_;
+    size_ = 0;
+    if (blocks > 0)
+    {
+      uint32_t last_count;
+      memcpy(&last_count, data_ + header_bytes_ + (blocks - 1)*block_bytes_, sizeof(uint32_t));
+      size_ = (blocks - 1)*block_size_ + last_count;
+    }
+
+    return true;
+  }
+
+  void FlightRecordReader::close()
+  {
+    if (data_)
+    {
+      munmap(const_cast<char*>(data_), file_bytes_);
+    }
+
+    data_ = NULL;
+    file_bytes_ = 0;
+    size_ = 0;
+    joint_names_.clear();
+  }
+
+  uint64_t FlightRecordReader::size() const
+  {
+    return size_;
+  }
+
+  const std::vector<std::string> &FlightRecordReader::jointNames() const
+  {
+    return joint_names_;
+  }
+
+  double FlightRecordReader::time(uint64_t i) const
+  {
+    return *scalarColumn(i, 0);
+  }
+
+  double FlightRecordReader::stamp(uint64_t i) const
+  {
+    return *scalarColumn(i, 1);
+  }
+
+  double FlightRecordReader::dt(uint64_t i) const
+  {
+    return *scalarColumn(i, 2);
+  }
+
+  bool FlightRecordReader::active(uint64_t i) const
+  {
+    return *scalarColumn(i, 3) != 0.0;
+  }
+
+  unsigned int FlightRecordReader::goal(uint64_t i) const
+  {
+    return static_cast<unsigned int>(*scalarColumn(i, 4));
+  }
+
+  const double *FlightRecordReader::statePosition(uint64_t i) const
+  {
+    return jointColumn(i, 0);
+  }
+
+  const double *FlightRecordReader::stateVelocity(uint64_t i) const
+  {
+    return jointColumn(i, 1);
+  }
+
+  const double *FlightRecordReader::stateEffort(uint64_t i) const
+  {
+    return jointColumn(i, 2);
+  }
+
+  const double *FlightRecordReader::commandPosition(uint64_t i) const
+  {
+    return jointColumn(i, 3);
+  }
+
+  const double *FlightRecordReader::commandVelocity(uint64_t i) const
+  {
+    return jointColumn(i, 4);
+  }
+
+  const double *FlightRecordReader::commandEffort(uint64_t i) const
+  {
+    return jointColumn(i, 5);
+  }
+
+  bool FlightRecordReader::getCycle(uint64_t i, sensor_msgs::JointState &state, sensor_msgs::JointState &command) const
+  {
+    if (i >= size_)
+    {
+      return false;
+    }
+
+    if (state.name != joint_names_)
+    {
+      state.name = joint_names_;
+    }
+
+    state.header.stamp = ros::Time(stamp(i));
+    state.position.assign(statePosition(i), statePosition(i) + num_joints_);
+    state.velocity.assign(stateVelocity(i), stateVelocity(i) + num_joints_);
+    state.effort.assign(stateEffort(i), stateEffort(i) + num_joints_);
+
+    if (command.name != joint_names_)
+    {
+      command.name = joint_names_;
+    }
+
+    command.header.stamp = ros::Time(stamp(i));
+    command.position.assign(commandPosition(i), commandPosition(i) + num_joints_);
+    command.velocity.assign(commandVelocity(i), commandVelocity(i) + num_joints_);
+    command.effort.assign(commandEffort(i), commandEffort(i) + num_joints_);
+    return true;
+  }
+
+  const double *FlightRecordReader::scalarColumn(uint64_t i, unsigned int column) const
+  {
+    const double *columns = reinterpret_cast<const double*>(data_ + header_bytes_ + (i/block_size_)*block_bytes_ + 2*sizeof(uint32_t));
+    return columns + column*block_size_ + i%block_size_;
+  }
+
+  const double *FlightRecordReader::jointColumn(uint64_t i, unsigned int column) const
+  {
+    const double *columns = reinterpret_cast<const double*>(data_ + header_bytes_ + (i/block_size_)*block_bytes_ + 2*sizeof(uint32_t));
+    return columns + FLIGHT_RECORD_SCALAR_COLUMNS*block_size_ + (column*block_size_ + i%block_size_)*num_joints_;
+  }
+}
@@ -0,0 +1,232 @@
+#include <generic_control_toolbox/flight_recorder.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+namespace generic_control_toolbox
+{
+  uint64_t flightRecordBlockBytes(uint32_t num_joints, uint32_t block_size)
+  {
+    return 2*sizeof(uint32_t) + sizeof(double)*block_size*(FLIGHT_RECORD_SCALAR_COLUMNS + FLIGHT_RECORD_JOINT_COLUMNS*num_joints);
+  }
+
+  FlightRecorder::FlightRecorder() : fd_(-1), num_joints_(0), capacity_(0), block_size_(0), stride_(0), header_bytes_(0), block_bytes_(0), block_index_(0), block_count_(0), head_(0), tail_(0), dropped_(0), record_time_ns_(0), recorded_(0), stop_(false) {}
+
+  FlightRecorder::~FlightRecorder()
+  {
+    stop();
+  }
+
+  bool FlightRecorder::start(const std::string &file_name, const std::vector<std::string> &joint_names, unsigned int capacity, unsigned int block_size)
+  {
+    if (isRunning())
+    {
+      ROS_ERROR("FlightRecorder: tried to start a recorder which is already running");
+      return false;
+    }
+
+    if (capacity == 0 || block_size == 0)
+    {
+      ROS_ERROR("FlightRecorder: the ring buffer capacity and block size must be positive");
+      return false;
+    }
+
+    fd_ = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+    {
+      ROS_ERROR("FlightRecorder: failed to open %s: %s", file_name.c_str(), strerror(errno));
+      return false;
+    }
+
+    num_joints_ = joint_names.size();
+    capacity_ = capacity;
+    block_size_ = block_size;
+    stride_ = FLIGHT_RECORD_SCALAR_COLUMNS + FLIGHT_RECORD_JOINT_COLUMNS*num_joints_;
+    ring_.assign(static_cast<size_t>(capacity_)*stride_, 0.0);
+    block_bytes_ = flightRecordBlockBytes(num_joints_, block_size_);
+    block_.assign(block_bytes_, 0);
+    block_index_ = 0;
+    block_count_ = 0;
+
+    FlightRecordHeader header;
+    memcpy(header.magic, FLIGHT_RECORD_MAGIC, sizeof(header.magic));
+    header.version = FLIGHT_RECORD_VERSION;
+    header.num_joints = num_joints_;
+    header.block_size = block_size_;
+    header.name_length = FLIGHT_RECORD_NAME_LENGTH;
+
+    std::vector<char> names(num_joints_*FLIGHT_RECORD_NAME_LENGTH, 0);
+    for (unsigned int i = 0; i < num_joints_; i++)
+    {
+      strncpy(&names[i*FLIGHT_RECORD_NAME_LENGTH], joint_names[i].c_str(), FLIGHT_RECORD_NAME_LENGTH - 1);
+    }
+
+    header_bytes_ = sizeof(header) + names.size();
+    if (pwrite(fd_, &header, sizeof(header), 0) != sizeof(header) || pwrite(fd_, names.data(), names.size(), sizeof(header)) != static_cast<ssize_t>(names.size()))
+    {
+      ROS_ERROR("FlightRecorder: failed to write the header of %s", file_name.c_str());
+      close(fd_);
+      fd_ = -1;
+      return false;
+    }
+
+    head_ = 0;
+    tail_ = 0;
+    dropped_ = 0;
+    record_time_ns_ = 0;
+    recorded_ = 0;
+    stop_ = false;
+    thread_ = std::thread(&FlightRecorder::writerThread, this);
+    ROS_INFO("FlightRecorder: recording %u joints to %s", num_joints_, file_name.c_str());
+    return true;
+  }
+
+  void FlightRecorder::stop()
+  {
+    if (!isRunning())
+    {
+      return;
+    }
+
+    stop_ = true;
+    thread_.join();
+    close(fd_);
+    fd_ = -1;
+    ROS_INFO("FlightRecorder: recorded %lu cycles, dropped %lu, average record time %.3f us", (unsigned long) recorded_.load(), (unsigned long) dropped_.load(), 1e6*averageRecordTime());
+  }
+
+  bool FlightRecorder::isRunning() const
+  {
+    return fd_ >= 0;
+  }
+
+  bool FlightRecorder::record(const sensor_msgs::JointState &state, const ros::Duration &dt, const sensor_msgs::JointState &command, bool active, unsigned int goal)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t head = head_.load(std::memory_order_relaxed);
+
+    if (head - tail_.load(std::memory_order_acquire) >= capacity_)
+    {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    double *r = &ring_[(head % capacity_)*stride_];
+    r[0] = ros::Time::now().toSec();
+    r[1] = state.header.stamp.toSec();
+    r[2] = dt.toSec();
+    r[3] = active ? 1.0 : 0.0;
+    r[4] = goal;
+    r += FLIGHT_RECORD_SCALAR_COLUMNS;
+    copyJointValues(state.position, r);
+    copyJointValues(state.velocity, r + num_joints_);
+    copyJointValues(state.effort, r + 2*num_joints_);
+    copyJointValues(command.position, r + 3*num_joints_);
+    copyJointValues(command.velocity, r + 4*num_joints_);
+    copyJointValues(command.effort, r + 5*num_joints_);
+    head_.store(head + 1, std::memory_order_release);
+
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    record_time_ns_.store(record_time_ns_.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+    recorded_.store(recorded_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  uint64_t FlightRecorder::droppedCycles() const
+  {
+    return dropped_.load();
+  }
+
+  double FlightRecorder::averageRecordTime() const
+  {
+    uint64_t recorded = recorded_.load();
+    if (recorded == 0)
+    {
+      return 0.0;
+    }
+
+    return 1e-9*record_time_ns_.load()/recorded;
+  }
+
+  void FlightRecorder::copyJointValues(const std::vector<double> &values, double *out) const
+  {
+    if (values.size() != num_joints_)
+    {
+      std::fill(out, out + num_joints_, std::numeric_limits<double>::quiet_NaN());
+      return;
+    }
+
+    std::copy(values.begin(), values.end(), out);
+  }
+
+  void FlightRecorder::writerThread()
+  {
+    while (!stop_)
+    {
+      if (!drain())
+      {
+        break;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    drain();
+  }
+
+  bool FlightRecorder::drain()
+  {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+
+    if (tail == head)
+    {
+      return true;
+    }
+
+    while (tail != head)
+    {
+      const double *r = &ring_[(tail % capacity_)*stride_];
+      double *columns = reinterpret_cast<double*>(&block_[2*sizeof(uint32_t)]);
+
+      for (unsigned int c = 0; c < FLIGHT_RECORD_SCALAR_COLUMNS; c++)
+      {
+        columns[c*block_size_ + block_count_] = r[c];
+      }
+
+      columns += FLIGHT_RECORD_SCALAR_COLUMNS*block_size_;
+      r += FLIGHT_RECORD_SCALAR_COLUMNS;
+      for (unsigned int c = 0; c < FLIGHT_RECORD_JOINT_COLUMNS; c++)
+      {
+        std::copy(r + c*num_joints_, r + (c + 1)*num_joints_, columns + (c*block_size_ + block_count_)*num_joints_);
+      }
+
+      tail++;
+      tail_.store(tail, std::memory_order_release);
+      block_count_++;
+
+      if (block_count_ == block_size_ || tail == head) // write full blocks, and rewrite the partial one in place
+      {
+        memcpy(&block_[0], &block_count_, sizeof(uint32_t));
+        if (pwrite(fd_, block_.data(), block_bytes_, header_bytes_ + block_index_*block_bytes_) != static_cast<ssize_t>(block_bytes_))
+        {
+          ROS_ERROR("FlightRecorder: failed to write to the flight record: %s", strerror(errno));
+          return false;
+        }
+
+        if (block_count_ == block_size_)
+        {
+          block_index_++;
+          block_count_ = 0;
+          std::fill(block_.begin(), block_.end(), 0);
+        }
+      }
+    }
+
+    return true;
+  }
+}
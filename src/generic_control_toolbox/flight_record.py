@@ -0,0 +1,84 @@
+#!/usr/bin/env python
+import struct
+import sys
+import numpy as np
+
+"""
+    @package flight_record
+    This module loads the flight records written by the FlightRecorder of the controller action node into numpy arrays.
+"""
+
+MAGIC = b"GCTFREC\0"
+VERSION = 2
+HEADER_FORMAT = "<8sIIII"
+SCALAR_COLUMNS = ["time", "stamp", "dt", "active", "goal"]
+JOINT_COLUMNS = ["state_position", "state_velocity", "state_effort", "command_position", "command_velocity", "command_effort"]
+
+
+def load(file_name):
+    """Load a flight record.
+
+       The file is memory-mapped, and each column is returned as a numpy array. Scalar columns have shape (cycles,)
+       and joint columns have shape (cycles, joints).
+
+       @param file_name The flight record file.
+       @return A tuple with the list of joint names and a dictionary of columns.
+    """
+
+    data = np.memmap(file_name, dtype=np.uint8, mode="r")
+    header_size = struct.calcsize(HEADER_FORMAT)
+    magic, version, num_joints, block_size, name_length = struct.unpack(HEADER_FORMAT, data[:header_size].tobytes())
+
+    if magic != MAGIC or version != VERSION:
+        raise ValueError(file_name + " is not a flight record of version " + str(VERSION))
+
+    names = []
+    for i in range(num_joints):
+        raw = data[header_size + i*name_length:header_size + (i + 1)*name_length].tobytes()
+        names.append(raw.split(b"\0", 1)[0].decode())
+
+    offset = header_size + num_joints*name_length
+    block_bytes = 8 + 8*block_size*(len(SCALAR_COLUMNS) + len(JOINT_COLUMNS)*num_joints)
+    num_blocks = (len(data) - offset)//block_bytes
+
+    columns = dict((name, []) for name in SCALAR_COLUMNS + JOINT_COLUMNS)
+    for b in range(num_blocks):
+        start = offset + b*block_bytes
+        count = int(np.frombuffer(data, dtype=np.uint32, count=1, offset=start)[0])
+        values = np.frombuffer(data, dtype=np.float64, count=(block_bytes - 8)//8, offset=start + 8)
+
+        for c, name in enumerate(SCALAR_COLUMNS):
+            columns[name].append(values[c*block_size:c*block_size + count])
+
+        joint_values = values[len(SCALAR_COLUMNS)*block_size:].reshape(len(JOINT_COLUMNS), block_size, num_joints)
+        for c, name in enumerate(JOINT_COLUMNS):
+            columns[name].append(joint_values[c, :count, :])
+
+    for name in SCALAR_COLUMNS:
+        columns[name] = np.concatenate(columns[name]) if num_blocks > 0 else np.zeros(0)
+
+    for name in JOINT_COLUMNS:
+        columns[name] = np.concatenate(columns[name]) if num_blocks > 0 else np.zeros((0, num_joints))
+
+    columns["active"] = columns["active"] != 0
+    columns["goal"] = columns["goal"].astype(np.uint32)
+    return names, columns
+
+
+def export_npz(file_name, npz_file_name):
+    """Export a flight record to a numpy .npz archive.
+
+       @param file_name The flight record file.
+       @param npz_file_name The output archive.
+    """
+
+    names, columns = load(file_name)
+    np.savez(npz_file_name, joint_names=np.array(names), **columns)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print("Usage: flight_record.py <flight record> <output.npz>")
+        sys.exit(1)
+
+    export_npz(sys.argv[1], sys.argv[2])
@@ -0,0 +1,121 @@
+#include <generic_control_toolbox/joint_projection.hpp>
+
+namespace generic_control_toolbox
+{
+  JointProjection::JointProjection() : input_size_(0), complete_(false) {}
+
+  JointProjection::~JointProjection() {}
+
+  void JointProjection::setJoints(const std::vector<std::string> &joints)
+  {
+    joints_ = joints;
+    index_.assign(joints_.size(), -1);
+    input_size_ = 0;
+    complete_ = false;
+  }
+
+  const std::vector<std::string> &JointProjection::joints() const
+  {
+    return joints_;
+  }
+
+  bool JointProjection::isSet() const
+  {
+    return !joints_.empty();
+  }
+
+  bool JointProjection::project(const sensor_msgs::JointState &in, sensor_msgs::JointState &out)
+  {
+    if (!indexMatches(in))
+    {
+      buildIndex(in);
+    }
+
+    out.header.seq = in.header.seq;
+    out.header.stamp = in.header.stamp;
+    out.header.frame_id.assign(in.header.frame_id);
+
+    unsigned long n = 0;
+    for (unsigned long i = 0; i < index_.size(); i++)
+    {
+      n += index_[i] >= 0;
+    }
+
+    out.name.resize(n);
+    out.position.resize(in.position.size() == in.name.size() ? n : 0);
+    out.velocity.resize(in.velocity.size() == in.name.size() ? n : 0);
+    out.effort.resize(in.effort.size() == in.name.size() ? n : 0);
+
+    unsigned long j = 0;
+    for (unsigned long i = 0; i < index_.size(); i++)
+    {
+      if (index_[i] < 0)
+      {
+        continue;
+      }
+
+      if (out.name[j] != joints_[i])
+      {
+        out.name[j] = joints_[i];
+      }
+
+      if (!out.position.empty())
+      {
+        out.position[j] = in.position[index_[i]];
+      }
+
+      if (!out.velocity.empty())
+      {
+        out.velocity[j] = in.velocity[index_[i]];
+      }
+
+      if (!out.effort.empty())
+      {
+        out.effort[j] = in.effort[index_[i]];
+      }
+
+      j++;
+    }
+
+    return complete_;
+  }
+
+  void JointProjection::buildIndex(const sensor_msgs::JointState &in)
+  {
+    complete_ = true;
+    for (unsigned long i = 0; i < joints_.size(); i++)
+    {
+      index_[i] = -1;
+      for (unsigned long j = 0; j < in.name.size(); j++)
+      {
+        if (in.name[j] == joints_[i])
+        {
+          index_[i] = j;
+          break;
+        }
+      }
+
+      complete_ = complete_ && index_[i] >= 0;
+    }
+
+    input_size_ = in.name.size();
+  }
+
+  bool JointProjection::indexMatches(const sensor_msgs::JointState &in) const
+  {
+    if (in.name.size() != input_size_)
+    {
+      return false;
+    }
+
+    for (unsigned long i = 0; i < index_.size(); i++)
+    {
+      if (index_[i] >= 0 && in.name[index_[i]] != joints_[i])
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
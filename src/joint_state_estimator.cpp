@@ -0,0 +1,97 @@
+#include <generic_control_toolbox/joint_state_estimator.hpp>
+#include <generic_control_toolbox/controller_template.hpp>
+
+namespace generic_control_toolbox
+{
+  JointStateEstimator::JointStateEstimator(double alpha, double beta, double gamma) : alpha_(0.5), beta_(0.1), gamma_(0.01), initialized_(false)
+  {
+    setGains(alpha, beta, gamma);
+  }
+
+  JointStateEstimator::~JointStateEstimator() {}
+
+  bool JointStateEstimator::setGains(double alpha, double beta, double gamma)
+  {
+    if (alpha <= 0 || alpha >= 1 || beta <= 0 || beta >= 2 || gamma <= 0 || gamma >= 4*alpha*beta/(2 - alpha))
+    {
+      ROS_ERROR("JointStateEstimator: unstable gains alpha = %.3f, beta = %.3f, gamma = %.3f", alpha, beta, gamma);
+      return false;
+    }
+
+    alpha_ = alpha;
+    beta_ = beta;
+    gamma_ = gamma;
+    return true;
+  }
+
+  void JointStateEstimator::reset()
+  {
+    initialized_ = false;
+  }
+
+  bool JointStateEstimator::update(sensor_msgs::JointState &state, const ros::Time &stamp)
+  {
+    unsigned long n = state.name.size();
+    if (state.position.size() != n || n == 0)
+    {
+      return false;
+    }
+
+    Eigen::Map<const Eigen::VectorXd> measured(state.position.data(), n);
+    double dt = (stamp - last_stamp_).toSec();
+
+    if (!initialized_ || position_.size() != static_cast<long>(n) || dt <= 0 || dt > MAX_DT)
+    {
+      if (position_.size() != static_cast<long>(n))
+      {
+        position_.resize(n);
+        velocity_.resize(n);
+        acceleration_.resize(n);
+        residual_.resize(n);
+      }
+
+      position_ = measured;
+      if (state.velocity.size() == n)
+      {
+        velocity_ = Eigen::Map<const Eigen::VectorXd>(state.velocity.data(), n);
+      }
+      else
+      {
+        velocity_.setZero();
+      }
+
+      acceleration_.setZero();
+      initialized_ = true;
+    }
+    else
+    {
+      // predict with a constant acceleration and correct with the position residual
+      position_ += dt*velocity_ + 0.5*dt*dt*acceleration_;
+      velocity_ += dt*acceleration_;
+      residual_ = measured - position_;
+      position_ += alpha_*residual_;
+      velocity_ += (beta_/dt)*residual_;
+      acceleration_ += (2*gamma_/(dt*dt))*residual_;
+    }
+
+    last_stamp_ = stamp;
+    state.velocity.resize(n); // allocates only if the driver does not publish velocities
+    Eigen::Map<Eigen::VectorXd>(state.velocity.data(), n) = velocity_;
+    return true;
+  }
+
+  const Eigen::VectorXd &JointStateEstimator::position() const
+  {
+    return position_;
+  }
+
+  const Eigen::VectorXd &JointStateEstimator::velocity() const
+  {
+    return velocity_;
+  }
+
+  const Eigen::VectorXd &JointStateEstimator::acceleration() const
+  {
+    return acceleration_;
+  }
+}
@@ -0,0 +1,124 @@
+#include <generic_control_toolbox/joint_state_predictor.hpp>
+#include <generic_control_toolbox/controller_template.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace generic_control_toolbox
+{
+  JointStatePredictor::JointStatePredictor(double actuation_delay, unsigned int capacity) : targets_(capacity > 0 ? capacity : 1), head_(0), size_(0), error_count_(0), actuation_delay_(actuation_delay), squared_error_(0.0), max_error_(0.0) {}
+
+  JointStatePredictor::~JointStatePredictor() {}
+
+  void JointStatePredictor::setActuationDelay(double actuation_delay)
+  {
+    actuation_delay_ = actuation_delay;
+  }
+
+  double JointStatePredictor::actuationDelay() const
+  {
+    return actuation_delay_;
+  }
+
+  bool JointStatePredictor::predict(const sensor_msgs::JointState &state, const ros::Time &stamp, const Eigen::VectorXd &velocity, const Eigen::VectorXd &acceleration, const ros::Time &now, sensor_msgs::JointState &predicted)
+  {
+    unsigned long n = state.name.size();
+    if (state.position.size() != n || velocity.size() != static_cast<long>(n) || acceleration.size() != static_cast<long>(n))
+    {
+      return false;
+    }
+
+    double horizon = std::max(0.0, (now - stamp).toSec() + actuation_delay_);
+
+    copyJointState(state, predicted);
+    predicted.header.stamp = stamp + ros::Duration(horizon);
+    predicted.velocity.resize(n);
+
+    Eigen::Map<Eigen::VectorXd> position(predicted.position.data(), n);
+    position += horizon*velocity + 0.5*horizon*horizon*acceleration;
+    Eigen::Map<Eigen::VectorXd>(predicted.velocity.data(), n) = velocity + horizon*acceleration;
+
+    // keep the prediction until it can be compared to the measurements
+    if (predictions_.rows() != static_cast<long>(n))
+    {
+      resize(n);
+    }
+
+    if (size_ == targets_.size()) // drop the oldest prediction
+    {
+      head_ = (head_ + 1) % targets_.size();
+      size_--;
+    }
+
+    unsigned long slot = (head_ + size_) % targets_.size();
+    predictions_.col(slot) = position;
+    targets_[slot] = predicted.header.stamp;
+    size_++;
+    return true;
+  }
+
+  void JointStatePredictor::observe(const sensor_msgs::JointState &state, const ros::Time &stamp)
+  {
+    unsigned long n = state.name.size();
+    if (state.position.size() != n || n == 0)
+    {
+      return;
+    }
+
+    if (predictions_.rows() != static_cast<long>(n))
+    {
+      resize(n);
+    }
+
+    Eigen::Map<const Eigen::VectorXd> measured(state.position.data(), n);
+    double dt = (stamp - last_stamp_).toSec();
+
+    while (size_ > 0 && targets_[head_] <= stamp)
+    {
+      if (!last_stamp_.isZero() && dt > 0 && dt <= MAX_DT && targets_[head_] > last_stamp_)
+      {
+        // compare to the measured positions interpolated at the predicted time
+        double w = (targets_[head_] - last_stamp_).toSec()/dt;
+        squared_error_ += (predictions_.col(head_) - last_measured_ - w*(measured - last_measured_)).squaredNorm();
+        max_error_ = std::max(max_error_, (predictions_.col(head_) - last_measured_ - w*(measured - last_measured_)).cwiseAbs().maxCoeff());
+        error_count_ += n;
+      }
+
+      head_ = (head_ + 1) % targets_.size();
+      size_--;
+    }
+
+    last_measured_ = measured;
+    last_stamp_ = stamp;
+  }
+
+  unsigned long JointStatePredictor::errorCount() const
+  {
+    return error_count_;
+  }
+
+  double JointStatePredictor::rmsError() const
+  {
+    return error_count_ > 0 ? std::sqrt(squared_error_/error_count_) : 0.0;
+  }
+
+  double JointStatePredictor::maxError() const
+  {
+    return max_error_;
+  }
+
+  void JointStatePredictor::resetError()
+  {
+    error_count_ = 0;
+    squared_error_ = 0.0;
+    max_error_ = 0.0;
+  }
+
+  void JointStatePredictor::resize(unsigned long n)
+  {
+    predictions_.resize(n, targets_.size());
+    last_measured_.resize(n);
+    last_stamp_ = ros::Time();
+    head_ = 0;
+    size_ = 0;
+  }
+}
@@ -4,7 +4,9 @@ namespace generic_control_toolbox
 {
     KDLManager::KDLManager(const std::string &chain_base_link, ros::NodeHandle nh) : chain_base_link_(chain_base_link), nh_(nh)
     {
-      if(!model_.initParam("/robot_description"))
+      model_ = RobotModelCache::getModel("/robot_description");
+      listener_ = RobotModelCache::getTransformListener();
+      if(!model_)
       {
         throw std::runtime_error("ERROR getting robot description (/robot_description)");
       }
@@ -132,7 +134,7 @@ namespace generic_control_toolbox
       KDL::Tree tree;
       KDL::Joint kdl_joint;
       KDL::Chain chain;
-      kdl_parser::treeFromUrdfModel(model_, tree); // convert URDF description of the robot into a KDL tree
+      kdl_parser::treeFromUrdfModel(*model_, tree); // convert URDF description of the robot into a KDL tree
       if(!tree.getChain(chain_base_link_, end_effector_link, chain))
       {
         ROS_ERROR_STREAM("Failed to find chain <" << chain_base_link_ << ", " << end_effector_link << "> in the kinematic tree");
@@ -493,7 +495,7 @@ namespace generic_control_toolbox
           continue;
         }
 
-        joint = model_.getJoint(chain_[arm].getSegment(i).getJoint().getName());
+        joint = model_->getJoint(chain_[arm].getSegment(i).getJoint().getName());
         limits = joint->limits;
         q_min(j) = limits->lower;
         q_max(j) = limits->upper;
@@ -504,6 +506,19 @@ namespace generic_control_toolbox
       return true;
     }
 
+    bool KDLManager::getActuatedJointNames(const std::string &end_effector_link, std::vector<std::string> &names) const
+    {
+      int arm;
+
+      if (!getIndex(end_effector_link, arm))
+      {
+        return false;
+      }
+
+      names = actuated_joint_names_[arm];
+      return true;
+    }
+
     bool KDLManager::getJointPositions(const std::string &end_effector_link, const sensor_msgs::JointState &state, KDL::JntArray &q) const
     {
       int arm;
@@ -554,6 +569,12 @@ namespace generic_control_toolbox
       }
 
       KDL::JntArray q(chain_[arm].getNrOfJoints());
+      KDL::JntArrayVel q_dot(chain_[arm].getNrOfJoints());
+      if (!getChainJointState(state, arm, q, q_dot))
+      {
+        return false;
+      }
+
       KDL::JntSpaceInertiaMatrix B(chain_[arm].getNrOfJoints());
       dynamic_chain_[arm].JntToMass(q, B);
 
@@ -625,7 +646,7 @@ namespace generic_control_toolbox
       {
         try
         {
-          listener_.transformPose(target_frame, base_to_target, base_to_target);
+          listener_->transformPose(target_frame, base_to_target, base_to_target);
           break;
         }
         catch (tf::TransformException ex)
@@ -0,0 +1,131 @@
+#include <generic_control_toolbox/latency_tracer.hpp>
+#include <chrono>
+
+namespace generic_control_toolbox
+{
+  LatencyTracer::LatencyTracer() : segments_(NUM_SEGMENTS), running_(false), stop_(false), dropped_(0), period_(1.0)
+  {
+    msg_.segment.push_back("transport");
+    msg_.segment.push_back("queueing");
+    msg_.segment.push_back("compute");
+    msg_.segment.push_back("publish");
+    msg_.segment.push_back("total");
+    msg_.p50.resize(NUM_SEGMENTS, 0.0);
+    msg_.p90.resize(NUM_SEGMENTS, 0.0);
+    msg_.p99.resize(NUM_SEGMENTS, 0.0);
+    msg_.max.resize(NUM_SEGMENTS, 0.0);
+  }
+
+  LatencyTracer::~LatencyTracer()
+  {
+    stop();
+  }
+
+  bool LatencyTracer::start(const ros::Publisher &pub, double period)
+  {
+    if (isRunning())
+    {
+      ROS_ERROR("LatencyTracer: tried to start a tracer which is already running");
+      return false;
+    }
+
+    if (period <= 0)
+    {
+      ROS_ERROR("LatencyTracer: the statistics period must be positive");
+      return false;
+    }
+
+    pub_ = pub;
+    period_ = period;
+    stop_ = false;
+    running_ = true;
+    thread_ = std::thread(&LatencyTracer::statisticsThread, this);
+    return true;
+  }
+
+  void LatencyTracer::stop()
+  {
+    if (!isRunning())
+    {
+      return;
+    }
+
+    stop_ = true;
+    thread_.join();
+    running_ = false;
+  }
+
+  bool LatencyTracer::isRunning() const
+  {
+    return running_;
+  }
+
+  bool LatencyTracer::trace(const LatencyTrace &trace)
+  {
+    if (!traces_.push(trace))
+    {
+      dropped_++;
+      return false;
+    }
+
+    return true;
+  }
+
+  unsigned long LatencyTracer::droppedTraces() const
+  {
+    return dropped_;
+  }
+
+  void LatencyTracer::statisticsThread()
+  {
+    std::chrono::milliseconds drain_period(100);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now(), next_publish = next + std::chrono::nanoseconds(static_cast<long long>(1e9*period_));
+    LatencyTrace trace;
+
+    while (!stop_)
+    {
+      while (traces_.pop(trace))
+      {
+        segments_[TRANSPORT].add((trace.receive - trace.stamp).toSec());
+        segments_[QUEUEING].add((trace.cycle_start - trace.receive).toSec());
+        segments_[COMPUTE].add((trace.update_end - trace.cycle_start).toSec());
+        segments_[PUBLISH].add((trace.publish - trace.update_end).toSec());
+        segments_[TOTAL].add((trace.publish - trace.stamp).toSec());
+      }
+
+      if (std::chrono::steady_clock::now() >= next_publish)
+      {
+        publishStatistics();
+        next_publish += std::chrono::nanoseconds(static_cast<long long>(1e9*period_));
+      }
+
+      next += drain_period;
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  void LatencyTracer::publishStatistics()
+  {
+    if (segments_[TOTAL].count() == 0)
+    {
+      return;
+    }
+
+    for (unsigned int i = 0; i < NUM_SEGMENTS; i++)
+    {
+      msg_.p50[i] = segments_[i].percentile(50);
+      msg_.p90[i] = segments_[i].percentile(90);
+      msg_.p99[i] = segments_[i].percentile(99);
+      msg_.max[i] = segments_[i].max();
+    }
+
+    msg_.stamp = ros::Time::now();
+    msg_.cycles = segments_[TOTAL].count();
+    pub_.publish(msg_);
+
+    if (dropped_ > 0)
+    {
+      ROS_WARN_THROTTLE(10, "LatencyTracer: dropped %lu traces", dropped_.load());
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#include <generic_control_toolbox/multi_robot_action_node.hpp>
+
+namespace generic_control_toolbox
+{
+  MultiRobotActionNode::MultiRobotActionNode() : running_(false)
+  {
+    nh_ = ros::NodeHandle("~");
+  }
+
+  MultiRobotActionNode::~MultiRobotActionNode()
+  {
+    for (unsigned long i = 0; i < robots_.size(); i++)
+    {
+      if (robots_[i]->thread.joinable())
+      {
+        robots_[i]->thread.join();
+      }
+    }
+  }
+
+  bool MultiRobotActionNode::addRobot(const std::string &name, ControllerBase &controller)
+  {
+    if (running_)
+    {
+      ROS_ERROR("Robots cannot be added to a running node");
+      return false;
+    }
+
+    for (unsigned long i = 0; i < robots_.size(); i++)
+    {
+      if (robots_[i]->name == name)
+      {
+        ROS_ERROR("Robot %s was already added", name.c_str());
+        return false;
+      }
+    }
+
+    ros::NodeHandle robot_nh(nh_, name);
+    std::shared_ptr<Robot> robot(new Robot());
+    robot->name = name;
+    robot->controller = &controller;
+    robot->node = std::shared_ptr<ControllerActionNode>(new ControllerActionNode(robot_nh));
+
+    if (!robot_nh.getParam("priority", robot->priority))
+    {
+      robot->priority = 0;
+    }
+
+    if (!robot_nh.getParam("cpu", robot->cpu))
+    {
+      robot->cpu = -1; // not pinned
+    }
+
+    robots_.push_back(robot);
+    return true;
+  }
+
+  void MultiRobotActionNode::run()
+  {
+    if (robots_.empty())
+    {
+      ROS_ERROR("No robots to run");
+      return;
+    }
+
+    running_ = true;
+    for (unsigned long i = 0; i < robots_.size(); i++)
+    {
+      Robot &robot = *robots_[i];
+      robot.thread = std::thread(&ControllerActionNode::runController, robot.node.get(), std::ref(*robot.controller));
+
+      if (robot.priority > 0)
+      {
+        setThreadPriority(robot.thread, robot.priority);
+      }
+
+      if (robot.cpu >= 0)
+      {
+        setThreadAffinity(robot.thread, robot.cpu);
+      }
+    }
+
+    ROS_INFO("Running %lu robots", robots_.size());
+    ros::spin(); // actionlib servers of all controllers
+
+    for (unsigned long i = 0; i < robots_.size(); i++)
+    {
+      robots_[i]->thread.join();
+    }
+  }
+}
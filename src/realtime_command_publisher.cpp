@@ -0,0 +1,153 @@
+#include <generic_control_toolbox/realtime_command_publisher.hpp>
+#include <generic_control_toolbox/realtime_utils.hpp>
+#include <generic_control_toolbox/controller_template.hpp>
+
+namespace generic_control_toolbox
+{
+  RealtimeCommandPublisher::RealtimeCommandPublisher() : tracer_(nullptr), stop_(false), shared_(false), published_(0), dropped_(0), late_(0), poll_period_(0.0005), max_latency_(0.01) {}
+
+  RealtimeCommandPublisher::~RealtimeCommandPublisher()
+  {
+    stop();
+  }
+
+  bool RealtimeCommandPublisher::start(const ros::Publisher &pub, double poll_rate, double max_latency, int cpu, bool shared)
+  {
+    if (isRunning())
+    {
+      ROS_ERROR("RealtimeCommandPublisher: tried to start a publisher which is already running");
+      return false;
+    }
+
+    if (poll_rate <= 0 || max_latency <= 0)
+    {
+      ROS_ERROR("RealtimeCommandPublisher: the poll rate and maximum latency must be positive");
+      return false;
+    }
+
+    pub_ = pub;
+    poll_period_ = 1.0/poll_rate;
+    max_latency_ = max_latency;
+    shared_ = shared;
+    stop_ = false;
+    thread_ = std::thread(&RealtimeCommandPublisher::publishingThread, this);
+
+    if (cpu >= 0)
+    {
+      setThreadAffinity(thread_, cpu);
+    }
+
+    return true;
+  }
+
+  void RealtimeCommandPublisher::stop()
+  {
+    if (!isRunning())
+    {
+      return;
+    }
+
+    stop_ = true;
+    thread_.join();
+    ROS_INFO("RealtimeCommandPublisher: published %lu commands, dropped %lu, late %lu", published_.load(), dropped_.load(), late_.load());
+  }
+
+  bool RealtimeCommandPublisher::isRunning() const
+  {
+    return thread_.joinable();
+  }
+
+  void RealtimeCommandPublisher::setTracer(LatencyTracer *tracer)
+  {
+    tracer_ = tracer;
+  }
+
+  void RealtimeCommandPublisher::publish(const sensor_msgs::JointState &command)
+  {
+    Command &slot = commands_.writeBuffer();
+    copyJointState(command, slot.command);
+    slot.handoff = std::chrono::steady_clock::now();
+    slot.traced = false;
+
+    if (commands_.publish())
+    {
+      dropped_++;
+    }
+  }
+
+  void RealtimeCommandPublisher::publish(const sensor_msgs::JointState &command, const LatencyTrace &trace)
+  {
+    Command &slot = commands_.writeBuffer();
+    copyJointState(command, slot.command);
+    slot.handoff = std::chrono::steady_clock::now();
+    slot.trace = trace;
+    slot.traced = true;
+
+    if (commands_.publish())
+    {
+      dropped_++;
+    }
+  }
+
+  unsigned long RealtimeCommandPublisher::publishedCommands() const
+  {
+    return published_;
+  }
+
+  unsigned long RealtimeCommandPublisher::droppedCommands() const
+  {
+    return dropped_;
+  }
+
+  unsigned long RealtimeCommandPublisher::lateCommands() const
+  {
+    return late_;
+  }
+
+  void RealtimeCommandPublisher::publishingThread()
+  {
+    std::chrono::nanoseconds period(static_cast<long long>(1e9*poll_period_));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    while (!stop_)
+    {
+      if (commands_.update())
+      {
+        const Command &command = commands_.readBuffer();
+        if (shared_)
+        {
+          // a new message each time, since subscribers may keep a reference to it
+          sensor_msgs::JointState::Ptr msg(new sensor_msgs::JointState(command.command));
+          pub_.publish(msg);
+        }
+        else
+        {
+          pub_.publish(command.command);
+        }
+
+        published_++;
+
+        if (command.traced && tracer_)
+        {
+          LatencyTrace trace = command.trace;
+          trace.publish = ros::Time::now();
+          tracer_->trace(trace); // the only producer of traces while commands are published here
+        }
+
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - command.handoff).count() > max_latency_)
+        {
+          late_++;
+        }
+      }
+
+      next += period;
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      if (next < now) // do not try to catch up after a slow publish
+      {
+        next = now;
+      }
+
+      std::this_thread::sleep_until(next);
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#include <generic_control_toolbox/realtime_utils.hpp>
+#include <pthread.h>
+#include <cstring>
+
+namespace generic_control_toolbox
+{
+  bool setThreadPriority(std::thread &thread, int priority)
+  {
+    sched_param param;
+    param.sched_priority = priority;
+
+    int ret = pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param);
+    if (ret != 0)
+    {
+      ROS_WARN("Failed to set thread priority to %d: %s", priority, strerror(ret));
+      return false;
+    }
+
+    return true;
+  }
+
+  bool setThreadAffinity(std::thread &thread, int cpu)
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+
+    int ret = pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpus);
+    if (ret != 0)
+    {
+      ROS_WARN("Failed to pin thread to CPU %d: %s", cpu, strerror(ret));
+      return false;
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,141 @@
+#include <generic_control_toolbox/replay_runner.hpp>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace generic_control_toolbox
+{
+  ReplayRunner::ReplayRunner() : max_position_divergence_(0.0), max_velocity_divergence_(0.0), steps_(0) {}
+
+  ReplayRunner::~ReplayRunner() {}
+
+  bool ReplayRunner::open(const std::string &record_file)
+  {
+    if (!reader_.open(record_file))
+    {
+      return false;
+    }
+
+    ROS_INFO("ReplayRunner: loaded %lu cycles of %zu joints", (unsigned long) reader_.size(), reader_.jointNames().size());
+    return true;
+  }
+
+  void ReplayRunner::setGoalInjector(const boost::function<void (const ros::Time&)> &injector)
+  {
+    injector_ = injector;
+  }
+
+  bool ReplayRunner::run(ControllerBase &controller, bool realtime, const std::string &csv_file)
+  {
+    if (reader_.size() == 0)
+    {
+      ROS_ERROR("ReplayRunner: nothing to replay");
+      return false;
+    }
+
+    std::ofstream csv;
+    if (!csv_file.empty())
+    {
+      csv.open(csv_file.c_str());
+      if (!csv.is_open())
+      {
+        ROS_ERROR("ReplayRunner: failed to open %s", csv_file.c_str());
+        return false;
+      }
+
+      csv << "cycle,time,compute_time,position_divergence,velocity_divergence" << std::endl;
+    }
+
+    sensor_msgs::JointState state, recorded_command, command;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double first_time = reader_.time(0);
+
+    compute_time_.reset();
+    max_position_divergence_ = 0.0;
+    max_velocity_divergence_ = 0.0;
+    steps_ = 0;
+
+    for (uint64_t i = 0; i < reader_.size(); i++)
+    {
+      reader_.getCycle(i, state, recorded_command);
+      ros::Time time(reader_.time(i));
+      ros::Time::setNow(time);
+
+      if (injector_)
+      {
+        injector_(time);
+      }
+
+      if (realtime)
+      {
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<long long>(1e9*(reader_.time(i) - first_time))));
+      }
+
+      std::chrono::steady_clock::time_point step_start = std::chrono::steady_clock::now();
+      controller.updateControl(state, ros::Duration(reader_.dt(i)), command);
+      double compute_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - step_start).count();
+
+      double position_divergence = divergence(command.position, recorded_command.position);
+      double velocity_divergence = divergence(command.velocity, recorded_command.velocity);
+      compute_time_.add(compute_time);
+      max_position_divergence_ = std::max(max_position_divergence_, position_divergence);
+      max_velocity_divergence_ = std::max(max_velocity_divergence_, velocity_divergence);
+      steps_++;
+
+      if (csv.is_open())
+      {
+        csv << i << "," << reader_.time(i) << "," << compute_time << "," << position_divergence << "," << velocity_divergence << std::endl;
+      }
+    }
+
+    return true;
+  }
+
+  const TimingStatistics &ReplayRunner::computeTime() const
+  {
+    return compute_time_;
+  }
+
+  double ReplayRunner::maxPositionDivergence() const
+  {
+    return max_position_divergence_;
+  }
+
+  double ReplayRunner::maxVelocityDivergence() const
+  {
+    return max_velocity_divergence_;
+  }
+
+  std::string ReplayRunner::report() const
+  {
+    std::stringstream ss;
+    ss << "Replayed " << steps_ << " steps" << std::endl;
+    ss << compute_time_.summary("Compute time") << std::endl;
+    ss << "Max position divergence: " << max_position_divergence_ << std::endl;
+    ss << "Max velocity divergence: " << max_velocity_divergence_;
+    return ss.str();
+  }
+
+  double ReplayRunner::divergence(const std::vector<double> &replayed, const std::vector<double> &recorded) const
+  {
+    if (replayed.size() != recorded.size())
+    {
+      return recorded.empty() ? 0.0 : std::numeric_limits<double>::infinity();
+    }
+
+    double max = 0.0;
+    for (unsigned long i = 0; i < replayed.size(); i++)
+    {
+      if (std::isfinite(recorded[i]))
+      {
+        max = std::max(max, std::fabs(replayed[i] - recorded[i]));
+      }
+    }
+
+    return max;
+  }
+}
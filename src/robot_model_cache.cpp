@@ -0,0 +1,41 @@
+#include <generic_control_toolbox/robot_model_cache.hpp>
+
+namespace generic_control_toolbox
+{
+  std::mutex RobotModelCache::mutex_;
+  std::map<std::string, std::shared_ptr<const urdf::Model> > RobotModelCache::models_;
+  std::shared_ptr<tf::TransformListener> RobotModelCache::listener_;
+
+  std::shared_ptr<const urdf::Model> RobotModelCache::getModel(const std::string &param)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, std::shared_ptr<const urdf::Model> >::iterator it = models_.find(param);
+
+    if (it != models_.end())
+    {
+      return it->second;
+    }
+
+    std::shared_ptr<urdf::Model> model(new urdf::Model());
+    if (!model->initParam(param))
+    {
+      ROS_ERROR("RobotModelCache: failed to load the robot description (%s)", param.c_str());
+      return std::shared_ptr<const urdf::Model>();
+    }
+
+    models_[param] = model;
+    return model;
+  }
+
+  std::shared_ptr<tf::TransformListener> RobotModelCache::getTransformListener()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!listener_)
+    {
+      listener_ = std::shared_ptr<tf::TransformListener>(new tf::TransformListener());
+    }
+
+    return listener_;
+  }
+}
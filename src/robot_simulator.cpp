@@ -0,0 +1,300 @@
+#include <generic_control_toolbox/robot_simulator.hpp>
+
+namespace generic_control_toolbox
+{
+  RobotSimulator::RobotSimulator() : noise_(0.0, 1.0), uniform_(0.0, 1.0)
+  {
+    nh_ = ros::NodeHandle("~");
+  }
+
+  RobotSimulator::~RobotSimulator() {}
+
+  bool RobotSimulator::init()
+  {
+    std::string chain_base_link, command_mode;
+
+    if (!nh_.getParam("chain_base_link", chain_base_link))
+    {
+      ROS_ERROR("RobotSimulator: missing chain_base_link parameter");
+      return false;
+    }
+
+    if (!nh_.getParam("end_effectors", end_effectors_) || end_effectors_.empty())
+    {
+      ROS_ERROR("RobotSimulator: missing end_effectors parameter");
+      return false;
+    }
+
+    if (!nh_.getParam("rate", rate_))
+    {
+      ROS_WARN("RobotSimulator: missing rate parameter, setting default");
+      rate_ = 1000;
+    }
+
+    if (!nh_.getParam("command_mode", command_mode))
+    {
+      ROS_WARN("RobotSimulator: missing command_mode parameter, setting default");
+      command_mode = "position";
+    }
+
+    if (command_mode == "position")
+    {
+      command_mode_ = POSITION;
+    }
+    else if (command_mode == "velocity")
+    {
+      command_mode_ = VELOCITY;
+    }
+    else if (command_mode == "effort")
+    {
+      command_mode_ = EFFORT;
+    }
+    else
+    {
+      ROS_ERROR_STREAM("RobotSimulator: command_mode has value " << command_mode << " but admissible values are position, velocity and effort");
+      return false;
+    }
+
+    nh_.param("latency", latency_, 0.0);
+    nh_.param("position_noise", position_noise_, 0.0);
+    nh_.param("velocity_noise", velocity_noise_, 0.0);
+    nh_.param("drop_probability", drop_probability_, 0.0);
+    nh_.param("damping", damping_, 0.0);
+
+    try
+    {
+      kdl_manager_ = std::shared_ptr<KDLManager>(new KDLManager(chain_base_link, nh_));
+    }
+    catch (const std::runtime_error &e)
+    {
+      ROS_ERROR_STREAM("RobotSimulator: " << e.what());
+      return false;
+    }
+
+    std::vector<std::string> names;
+    for (unsigned long c = 0; c < end_effectors_.size(); c++)
+    {
+      if (!kdl_manager_->initializeArm(end_effectors_[c]) || !kdl_manager_->getActuatedJointNames(end_effectors_[c], names))
+      {
+        return false;
+      }
+
+      KDL::JntArray q_min(names.size()), q_max(names.size()), q_vel_lim(names.size());
+      kdl_manager_->getJointLimits(end_effectors_[c], q_min, q_max, q_vel_lim);
+
+      std::vector<unsigned int> indices;
+      for (unsigned long i = 0; i < names.size(); i++)
+      {
+        if (joint_index_.count(names[i]) == 0) // joints may be shared between chains
+        {
+          joint_index_[names[i]] = state_.name.size();
+          state_.name.push_back(names[i]);
+
+          if (q_min(i) < q_max(i))
+          {
+            q_min_.push_back(q_min(i));
+            q_max_.push_back(q_max(i));
+          }
+          else // continuous joint
+          {
+            q_min_.push_back(-std::numeric_limits<double>::infinity());
+            q_max_.push_back(std::numeric_limits<double>::infinity());
+          }
+        }
+
+        indices.push_back(joint_index_[names[i]]);
+      }
+
+      chain_indices_.push_back(indices);
+    }
+
+    unsigned int n = state_.name.size();
+    std::vector<double> initial_positions;
+    if (nh_.getParam("initial_positions", initial_positions) && initial_positions.size() == n)
+    {
+      state_.position = initial_positions;
+    }
+    else
+    {
+      ROS_WARN("RobotSimulator: missing initial_positions parameter for %u joints, starting at zero", n);
+      state_.position.assign(n, 0.0);
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+      state_.position[i] = std::max(q_min_[i], std::min(q_max_[i], state_.position[i]));
+    }
+
+    state_.velocity.assign(n, 0.0);
+    state_.effort.assign(n, 0.0);
+    command_position_ = state_.position;
+    command_velocity_.assign(n, 0.0);
+    command_effort_.assign(n, 0.0);
+
+    command_sub_ = nh_.subscribe("/joint_command", 1, &RobotSimulator::commandCb, this);
+    state_pub_ = nh_.advertise<sensor_msgs::JointState>("/joint_states", 1);
+    ROS_INFO("RobotSimulator: simulating %u joints at %.1f Hz", n, rate_);
+    return true;
+  }
+
+  void RobotSimulator::run()
+  {
+    ros::Rate r(rate_);
+    double dt = 1.0/rate_;
+
+    while (ros::ok())
+    {
+      ros::spinOnce();
+      applyCommands(ros::Time::now());
+      step(dt);
+      publishState();
+      r.sleep();
+    }
+  }
+
+  void RobotSimulator::commandCb(const sensor_msgs::JointState::ConstPtr &msg)
+  {
+    pending_commands_.push_back(msg);
+    pending_times_.push_back(ros::Time::now());
+  }
+
+  void RobotSimulator::applyCommands(const ros::Time &now)
+  {
+    while (!pending_commands_.empty() && (now - pending_times_.front()).toSec() >= latency_)
+    {
+      const sensor_msgs::JointState &command = *pending_commands_.front();
+      std::map<std::string, unsigned int>::const_iterator it;
+
+      for (unsigned long i = 0; i < command.name.size(); i++)
+      {
+        it = joint_index_.find(command.name[i]);
+        if (it == joint_index_.end())
+        {
+          continue;
+        }
+
+        if (command.position.size() == command.name.size())
+        {
+          command_position_[it->second] = command.position[i];
+        }
+
+        if (command.velocity.size() == command.name.size())
+        {
+          command_velocity_[it->second] = command.velocity[i];
+        }
+        else if (command_mode_ == POSITION && command.position.size() == command.name.size())
+        {
+          command_velocity_[it->second] = 0.0; // no feed-forward
+        }
+
+        if (command.effort.size() == command.name.size())
+        {
+          command_effort_[it->second] = command.effort[i];
+        }
+      }
+
+      pending_commands_.pop_front();
+      pending_times_.pop_front();
+    }
+  }
+
+  void RobotSimulator::step(double dt)
+  {
+    if (command_mode_ == EFFORT)
+    {
+      stepDynamics(dt);
+      return;
+    }
+
+    for (unsigned long i = 0; i < state_.name.size(); i++)
+    {
+      double q;
+
+      if (command_mode_ == POSITION)
+      {
+        // the commanded velocity carries the position forward until the next command
+        q = command_position_[i];
+        command_position_[i] = std::max(q_min_[i], std::min(q_max_[i], q + command_velocity_[i]*dt));
+      }
+      else
+      {
+        q = state_.position[i] + command_velocity_[i]*dt;
+      }
+
+      q = std::max(q_min_[i], std::min(q_max_[i], q));
+      state_.velocity[i] = (q - state_.position[i])/dt;
+      state_.position[i] = q;
+      state_.effort[i] = command_effort_[i];
+    }
+  }
+
+  void RobotSimulator::stepDynamics(double dt)
+  {
+    Eigen::MatrixXd H, g, coriolis;
+    unsigned long n = state_.name.size();
+    std::vector<double> qddot_sum(n, 0.0);
+    std::vector<unsigned int> num_chains(n, 0); // number of chains which give the acceleration of each joint
+
+    // all the chains use the state at the start of the step
+    for (unsigned long c = 0; c < end_effectors_.size(); c++)
+    {
+      if (!kdl_manager_->getInertia(end_effectors_[c], state_, H) || !kdl_manager_->getGravity(end_effectors_[c], state_, g) || !kdl_manager_->getCoriolis(end_effectors_[c], state_, coriolis))
+      {
+        ROS_ERROR_THROTTLE(10, "RobotSimulator: failed to compute the dynamics of the chain ending in %s", end_effectors_[c].c_str());
+        continue;
+      }
+
+      const std::vector<unsigned int> &indices = chain_indices_[c];
+      Eigen::VectorXd tau(indices.size()), qdot(indices.size());
+      for (unsigned long i = 0; i < indices.size(); i++)
+      {
+        tau[i] = command_effort_[indices[i]];
+        qdot[i] = state_.velocity[indices[i]];
+      }
+
+      Eigen::VectorXd qddot = H.ldlt().solve(tau - coriolis.col(0) - g.col(0) - damping_*qdot);
+
+      for (unsigned long i = 0; i < indices.size(); i++)
+      {
+        qddot_sum[indices[i]] += qddot[i];
+        num_chains[indices[i]]++;
+      }
+    }
+
+    for (unsigned long j = 0; j < n; j++) // semi-implicit Euler, once per joint
+    {
+      if (num_chains[j] == 0)
+      {
+        continue;
+      }
+
+      state_.velocity[j] += qddot_sum[j]/num_chains[j]*dt;
+      state_.position[j] += state_.velocity[j]*dt;
+      state_.effort[j] = command_effort_[j];
+
+      if (state_.position[j] < q_min_[j] || state_.position[j] > q_max_[j])
+      {
+        state_.position[j] = std::max(q_min_[j], std::min(q_max_[j], state_.position[j]));
+        state_.velocity[j] = 0.0;
+      }
+    }
+  }
+
+  void RobotSimulator::publishState()
+  {
+    if (drop_probability_ > 0 && uniform_(generator_) < drop_probability_)
+    {
+      return;
+    }
+
+    published_ = state_;
+    for (unsigned long i = 0; i < published_.name.size(); i++)
+    {
+      published_.position[i] += position_noise_*noise_(generator_);
+      published_.velocity[i] += velocity_noise_*noise_(generator_);
+    }
+
+    published_.header.stamp = ros::Time::now();
+    state_pub_.publish(published_);
+  }
+}
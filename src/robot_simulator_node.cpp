@@ -0,0 +1,15 @@
+#include <generic_control_toolbox/robot_simulator.hpp>
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "robot_simulator");
+  generic_control_toolbox::RobotSimulator simulator;
+
+  if (!simulator.init())
+  {
+    return 1;
+  }
+
+  simulator.run();
+  return 0;
+}
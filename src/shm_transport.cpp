@@ -0,0 +1,339 @@
+#include <generic_control_toolbox/shm_transport.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+namespace generic_control_toolbox
+{
+  /**
+    Offset of the first record, aligned to a cache line.
+  **/
+  static uint64_t recordsOffset(uint32_t num_joints)
+  {
+    uint64_t offset = sizeof(ShmTransportHeader) + static_cast<uint64_t>(num_joints)*SHM_TRANSPORT_NAME_LENGTH;
+    return (offset + 63) & ~static_cast<uint64_t>(63);
+  }
+
+  /**
+    Size of a record, aligned to a cache line.
+  **/
+  static uint64_t recordBytes(uint32_t num_joints)
+  {
+    uint64_t bytes = 3*sizeof(uint64_t) + 3*static_cast<uint64_t>(num_joints)*sizeof(double);
+    return (bytes + 63) & ~static_cast<uint64_t>(63);
+  }
+
+  ShmTransport::ShmTransport() : header_(nullptr), records_(nullptr), bytes_(0), record_bytes_(0), num_joints_(0), capacity_(0) {}
+
+  ShmTransport::~ShmTransport()
+  {
+    ShmTransport::close();
+  }
+
+  void ShmTransport::close()
+  {
+    if (header_)
+    {
+      munmap(header_, bytes_);
+    }
+
+    header_ = nullptr;
+    records_ = nullptr;
+  }
+
+  bool ShmTransport::isOpen() const
+  {
+    return header_ != nullptr;
+  }
+
+  const std::vector<std::string> &ShmTransport::jointNames() const
+  {
+    return names_;
+  }
+
+  std::string ShmTransport::objectName(const std::string &topic)
+  {
+    std::string name = "/gct" + topic;
+    for (unsigned long i = 1; i < name.size(); i++)
+    {
+      if (name[i] == '/')
+      {
+        name[i] = '_';
+      }
+    }
+
+    return name;
+  }
+
+  bool ShmTransport::map(int fd, uint64_t bytes, bool writable)
+  {
+    void *addr = mmap(nullptr, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+      ROS_ERROR("ShmTransport: failed to map %s: %s", object_name_.c_str(), strerror(errno));
+      return false;
+    }
+
+    header_ = static_cast<ShmTransportHeader*>(addr);
+    bytes_ = bytes;
+    return true;
+  }
+
+  std::atomic<uint64_t> &ShmTransport::recordSeq(uint64_t i) const
+  {
+    return *reinterpret_cast<std::atomic<uint64_t>*>(records_ + (i % capacity_)*record_bytes_);
+  }
+
+  char *ShmTransport::recordData(uint64_t i) const
+  {
+    return records_ + (i % capacity_)*record_bytes_ + sizeof(uint64_t);
+  }
+
+  ShmJointStateWriter::ShmJointStateWriter() {}
+
+  ShmJointStateWriter::~ShmJointStateWriter()
+  {
+    close();
+  }
+
+  bool ShmJointStateWriter::open(const std::string &topic, const std::vector<std::string> &joint_names, unsigned int capacity)
+  {
+    close();
+
+    if (capacity == 0)
+    {
+      ROS_ERROR("ShmJointStateWriter: the ring capacity must be positive");
+      return false;
+    }
+
+    object_name_ = objectName(topic);
+    shm_unlink(object_name_.c_str()); // readers of a previous layout keep their mapping until they see it closed
+
+    int fd = shm_open(object_name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd < 0)
+    {
+      ROS_ERROR("ShmJointStateWriter: failed to create %s: %s", object_name_.c_str(), strerror(errno));
+      return false;
+    }
+
+    num_joints_ = joint_names.size();
+    capacity_ = capacity;
+    record_bytes_ = recordBytes(num_joints_);
+    uint64_t bytes = recordsOffset(num_joints_) + capacity_*record_bytes_;
+
+    if (ftruncate(fd, bytes) != 0 || !map(fd, bytes, true))
+    {
+      ROS_ERROR("ShmJointStateWriter: failed to allocate %s: %s", object_name_.c_str(), strerror(errno));
+      ::close(fd);
+      shm_unlink(object_name_.c_str());
+      return false;
+    }
+
+    ::close(fd); // a new object is zero-filled, which initializes the atomics and record sequence numbers
+    records_ = reinterpret_cast<char*>(header_) + recordsOffset(num_joints_);
+    names_ = joint_names;
+
+    char *names = reinterpret_cast<char*>(header_) + sizeof(ShmTransportHeader);
+    for (unsigned int i = 0; i < num_joints_; i++)
+    {
+      strncpy(names + i*SHM_TRANSPORT_NAME_LENGTH, joint_names[i].c_str(), SHM_TRANSPORT_NAME_LENGTH - 1);
+    }
+
+    header_->version = SHM_TRANSPORT_VERSION;
+    header_->num_joints = num_joints_;
+    header_->capacity = capacity_;
+    header_->name_length = SHM_TRANSPORT_NAME_LENGTH;
+    header_->record_bytes = record_bytes_;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header_->magic, SHM_TRANSPORT_MAGIC, sizeof(SHM_TRANSPORT_MAGIC)); // readers check the magic last
+    return true;
+  }
+
+  void ShmJointStateWriter::close()
+  {
+    if (!isOpen())
+    {
+      return;
+    }
+
+    header_->closed.store(1, std::memory_order_release);
+    ShmTransport::close();
+    shm_unlink(object_name_.c_str());
+  }
+
+  bool ShmJointStateWriter::write(const sensor_msgs::JointState &state)
+  {
+    if (!isOpen() || state.name != names_) // the readers index the records by the layout names
+    {
+      return false;
+    }
+
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    std::atomic<uint64_t> &seq = recordSeq(head);
+    uint64_t s = seq.load(std::memory_order_relaxed);
+
+    seq.store(s + 1, std::memory_order_relaxed); // odd, being written
+    std::atomic_thread_fence(std::memory_order_release);
+
+    char *data = recordData(head);
+    int64_t stamp = state.header.stamp.toNSec();
+    memcpy(data, &stamp, sizeof(int64_t));
+
+    uint64_t mask = 0;
+    double *values = reinterpret_cast<double*>(data + sizeof(int64_t) + sizeof(uint64_t));
+    const std::vector<double> *fields[3] = {&state.position, &state.velocity, &state.effort};
+    for (unsigned int f = 0; f < 3; f++)
+    {
+      if (fields[f]->size() == num_joints_)
+      {
+        memcpy(values + f*num_joints_, fields[f]->data(), num_joints_*sizeof(double));
+        mask |= static_cast<uint64_t>(1) << f;
+      }
+    }
+
+    memcpy(data + sizeof(int64_t), &mask, sizeof(uint64_t));
+
+    seq.store(s + 2, std::memory_order_release);
+    header_->head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  ShmJointStateReader::ShmJointStateReader() : last_head_(0) {}
+
+  ShmJointStateReader::~ShmJointStateReader() {}
+
+  bool ShmJointStateReader::open(const std::string &topic)
+  {
+    close();
+    object_name_ = objectName(topic);
+
+    int fd = shm_open(object_name_.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+      return false; // not created yet
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < sizeof(ShmTransportHeader) || !map(fd, info.st_size, false))
+    {
+      ::close(fd);
+      return false;
+    }
+
+    ::close(fd);
+
+    if (memcmp(header_->magic, SHM_TRANSPORT_MAGIC, sizeof(SHM_TRANSPORT_MAGIC)) != 0) // not initialized yet
+    {
+      close();
+      return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->version != SHM_TRANSPORT_VERSION || header_->name_length != SHM_TRANSPORT_NAME_LENGTH || header_->capacity == 0 || header_->record_bytes != recordBytes(header_->num_joints) || recordsOffset(header_->num_joints) + header_->capacity*header_->record_bytes > bytes_)
+    {
+      ROS_ERROR("ShmJointStateReader: %s has an incompatible layout", object_name_.c_str());
+      close();
+      return false;
+    }
+
+    num_joints_ = header_->num_joints;
+    capacity_ = header_->capacity;
+    record_bytes_ = header_->record_bytes;
+    records_ = reinterpret_cast<char*>(header_) + recordsOffset(num_joints_);
+
+    names_.resize(num_joints_);
+    const char *names = reinterpret_cast<const char*>(header_) + sizeof(ShmTransportHeader);
+    for (unsigned int i = 0; i < num_joints_; i++)
+    {
+      names_[i].assign(names + i*SHM_TRANSPORT_NAME_LENGTH, strnlen(names + i*SHM_TRANSPORT_NAME_LENGTH, SHM_TRANSPORT_NAME_LENGTH));
+    }
+
+    last_head_ = header_->head.load(std::memory_order_acquire);
+    return true;
+  }
+
+  bool ShmJointStateReader::writerClosed() const
+  {
+    return isOpen() && header_->closed.load(std::memory_order_acquire) != 0;
+  }
+
+  bool ShmJointStateReader::read(sensor_msgs::JointState &state)
+  {
+    if (!isOpen())
+    {
+      return false;
+    }
+
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+    if (head == last_head_)
+    {
+      return false;
+    }
+
+    if (state.name != names_)
+    {
+      state.name = names_;
+    }
+
+    state.position.resize(num_joints_);
+    state.velocity.resize(num_joints_);
+    state.effort.resize(num_joints_);
+
+    uint64_t mask;
+    for (unsigned int attempt = 0;; attempt++)
+    {
+      if (attempt == SHM_TRANSPORT_MAX_READ_ATTEMPTS) // e.g., the writer died in the middle of a write
+      {
+        return false;
+      }
+
+      uint64_t index = head - 1;
+      std::atomic<uint64_t> &seq = recordSeq(index);
+      uint64_t s1 = seq.load(std::memory_order_acquire);
+
+      if (s1 % 2 == 0)
+      {
+        const char *data = recordData(index);
+        int64_t stamp;
+        memcpy(&stamp, data, sizeof(int64_t));
+        memcpy(&mask, data + sizeof(int64_t), sizeof(uint64_t));
+
+        const double *values = reinterpret_cast<const double*>(data + sizeof(int64_t) + sizeof(uint64_t));
+        memcpy(state.position.data(), values, num_joints_*sizeof(double));
+        memcpy(state.velocity.data(), values + num_joints_, num_joints_*sizeof(double));
+        memcpy(state.effort.data(), values + 2*num_joints_, num_joints_*sizeof(double));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == s1)
+        {
+          state.header.stamp.fromNSec(stamp);
+          break;
+        }
+      }
+
+      head = header_->head.load(std::memory_order_acquire); // overwritten while reading, take the newest record
+    }
+
+    // keeps the capacity, so the next resize does not allocate
+    if (!(mask & SHM_TRANSPORT_POSITION))
+    {
+      state.position.clear();
+    }
+
+    if (!(mask & SHM_TRANSPORT_VELOCITY))
+    {
+      state.velocity.clear();
+    }
+
+    if (!(mask & SHM_TRANSPORT_EFFORT))
+    {
+      state.effort.clear();
+    }
+
+    last_head_ = head;
+    return true;
+  }
+}
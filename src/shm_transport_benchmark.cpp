@@ -0,0 +1,187 @@
+#include <generic_control_toolbox/shm_transport.hpp>
+#include <generic_control_toolbox/timing_statistics.hpp>
+#include <ros/callback_queue.h>
+#include <chrono>
+#include <memory>
+
+/**
+  Measures the one-way latency of the shared memory transport and of TCPROS
+  between two processes on the same host. Run one instance with the ~role
+  parameter set to "pong", which echoes the joint states it receives, and
+  one with ~role set to "ping", which sends ~count joint states with ~joints
+  joints and reports half of the round-trip times. The ~transport parameter
+  selects "shm" or "ros" in both instances. Two processes are needed since
+  roscpp shortcuts topics within a process.
+**/
+
+using namespace generic_control_toolbox;
+
+const std::string PING_TOPIC = "/shm_transport_benchmark/ping";
+const std::string PONG_TOPIC = "/shm_transport_benchmark/pong";
+
+class RosEcho
+{
+public:
+  RosEcho(ros::NodeHandle &nh, bool pong) : received_(false)
+  {
+    pub_ = nh.advertise<sensor_msgs::JointState>(pong ? PONG_TOPIC : PING_TOPIC, 1);
+    sub_ = nh.subscribe(pong ? PING_TOPIC : PONG_TOPIC, 1, &RosEcho::stateCb, this, ros::TransportHints().tcpNoDelay());
+  }
+
+  void stateCb(const sensor_msgs::JointState::ConstPtr &msg)
+  {
+    last_ = msg;
+    received_ = true;
+  }
+
+  ros::Publisher pub_;
+  ros::Subscriber sub_;
+  sensor_msgs::JointState::ConstPtr last_;
+  bool received_;
+};
+
+/**
+  Waits for the echo of a joint state.
+
+  @return False if the node shuts down, true otherwise.
+**/
+bool waitShm(ShmJointStateReader &reader, sensor_msgs::JointState &state, ros::Time stamp)
+{
+  while (ros::ok())
+  {
+    if (reader.read(state) && state.header.stamp == stamp)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool waitRos(RosEcho &echo, ros::Time stamp)
+{
+  while (ros::ok())
+  {
+    ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.001));
+    if (echo.received_ && echo.last_->header.stamp == stamp)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "shm_transport_benchmark");
+  ros::NodeHandle nh, pnh("~");
+  std::string role, transport;
+  int joints, count;
+
+  pnh.param<std::string>("role", role, "ping");
+  pnh.param<std::string>("transport", transport, "shm");
+  pnh.param<int>("joints", joints, 7);
+  pnh.param<int>("count", count, 10000);
+
+  if ((role != "ping" && role != "pong") || (transport != "shm" && transport != "ros") || joints < 1 || count < 1)
+  {
+    ROS_ERROR("Invalid parameters: role must be ping or pong, transport shm or ros, and joints and count positive");
+    return 1;
+  }
+
+  bool pong = role == "pong", shm = transport == "shm";
+  sensor_msgs::JointState state;
+  for (int i = 0; i < joints; i++)
+  {
+    state.name.push_back("joint_" + std::to_string(i));
+  }
+
+  state.position.assign(joints, 0.0);
+  state.velocity.assign(joints, 0.0);
+  state.effort.assign(joints, 0.0);
+
+  ShmJointStateWriter writer;
+  ShmJointStateReader reader;
+  std::shared_ptr<RosEcho> echo;
+
+  if (shm)
+  {
+    if (!writer.open(pong ? PONG_TOPIC : PING_TOPIC, state.name))
+    {
+      return 1;
+    }
+
+    while (ros::ok() && !reader.open(pong ? PING_TOPIC : PONG_TOPIC))
+    {
+      ROS_INFO_THROTTLE(5, "Waiting for the %s process", pong ? "ping" : "pong");
+      ros::Duration(0.01).sleep();
+    }
+  }
+  else
+  {
+    echo.reset(new RosEcho(nh, pong));
+    while (ros::ok() && (echo->pub_.getNumSubscribers() == 0 || echo->sub_.getNumPublishers() == 0))
+    {
+      ROS_INFO_THROTTLE(5, "Waiting for the %s process", pong ? "ping" : "pong");
+      ros::Duration(0.01).sleep();
+    }
+  }
+
+  if (pong)
+  {
+    ROS_INFO("Echoing joint states over %s", transport.c_str());
+    while (ros::ok())
+    {
+      if (shm)
+      {
+        if (reader.read(state))
+        {
+          writer.write(state);
+        }
+      }
+      else
+      {
+        ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.001));
+        if (echo->received_)
+        {
+          echo->pub_.publish(echo->last_);
+          echo->received_ = false;
+        }
+      }
+    }
+
+    return 0;
+  }
+
+  TimingStatistics latency(count);
+  for (int i = 0; i < count && ros::ok(); i++)
+  {
+    state.header.stamp.fromNSec(i + 1); // identifies the echo
+    state.position[0] = i;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (shm)
+    {
+      writer.write(state);
+      if (!waitShm(reader, state, state.header.stamp))
+      {
+        break;
+      }
+    }
+    else
+    {
+      echo->received_ = false;
+      echo->pub_.publish(state);
+      if (!waitRos(*echo, state.header.stamp))
+      {
+        break;
+      }
+    }
+
+    latency.add(0.5*std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  ROS_INFO_STREAM(latency.summary("One-way latency over " + transport + " with " + std::to_string(joints) + " joints"));
+  return 0;
+}
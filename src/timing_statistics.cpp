@@ -0,0 +1,73 @@
+#include <generic_control_toolbox/timing_statistics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+namespace generic_control_toolbox
+{
+  TimingStatistics::TimingStatistics(unsigned int window) : samples_(std::max(window, 1u), 0.0)
+  {
+    reset();
+  }
+
+  TimingStatistics::~TimingStatistics() {}
+
+  void TimingStatistics::reset()
+  {
+    count_ = 0;
+    next_ = 0;
+    sum_ = 0.0;
+    max_ = 0.0;
+  }
+
+  void TimingStatistics::add(double sample)
+  {
+    samples_[next_] = sample;
+    next_ = (next_ + 1) % samples_.size();
+    sum_ += sample;
+    max_ = count_ == 0 ? sample : std::max(max_, sample);
+    count_++;
+  }
+
+  unsigned long TimingStatistics::count() const
+  {
+    return count_;
+  }
+
+  double TimingStatistics::mean() const
+  {
+    if (count_ == 0)
+    {
+      return 0.0;
+    }
+
+    return sum_/count_;
+  }
+
+  double TimingStatistics::max() const
+  {
+    return max_;
+  }
+
+  double TimingStatistics::percentile(double p) const
+  {
+    unsigned long n = std::min(count_, static_cast<unsigned long>(samples_.size()));
+    if (n == 0)
+    {
+      return 0.0;
+    }
+
+    sorted_.assign(samples_.begin(), samples_.begin() + n);
+    unsigned long k = std::min(n - 1, static_cast<unsigned long>(std::ceil(p/100.0*n)) - (p > 0 ? 1 : 0));
+    std::nth_element(sorted_.begin(), sorted_.begin() + k, sorted_.end());
+    return sorted_[k];
+  }
+
+  std::string TimingStatistics::summary(const std::string &name) const
+  {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << name << ": n = " << count_ << ", mean = " << 1e6*mean() << " us, p50 = " << 1e6*percentile(50) << " us, p90 = " << 1e6*percentile(90) << " us, p99 = " << 1e6*percentile(99) << " us, max = " << 1e6*max() << " us";
+    return ss.str();
+  }
+}
@@ -5,6 +5,7 @@ namespace generic_control_toolbox
   WrenchManager::WrenchManager()
   {
     nh_ = ros::NodeHandle("~");
+    listener_ = RobotModelCache::getTransformListener();
     if (!nh_.getParam("wrench_manager/max_tf_attempts", max_tf_attempts_))
     {
       ROS_WARN("WrenchManager: Missing max_tf_attempts parameter, setting default");
@@ -40,7 +41,7 @@ namespace generic_control_toolbox
     {
       try
       {
-        listener_.transformPose(gripping_point_frame, sensor_to_gripping_point, sensor_to_gripping_point);
+        listener_->transformPose(gripping_point_frame, sensor_to_gripping_point, sensor_to_gripping_point);
         break;
       }
       catch (tf::TransformException ex)